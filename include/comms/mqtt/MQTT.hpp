@@ -9,11 +9,17 @@
  * - MQTTBroker: Central message broker
  * - MQTTPublisher: Publish messages to topics
  * - MQTTSubscriber: Subscribe and receive messages
+ * - MQTTBridge: Forward topics between brokers
+ * - MQTTBatchPublisher: Coalesce messages into batched transfers
+ * - MQTTBrokerStats: Latency histograms and throughput export
+ * - MQTTCodec: Payload compression profiles
  */
 
 #include "comms/mqtt/MQTTBroker.hpp"
 #include "comms/mqtt/MQTTPublisher.hpp"
 #include "comms/mqtt/MQTTSubscriber.hpp"
+#include "comms/mqtt/MQTTBridge.hpp"
+#include "comms/mqtt/MQTTBatchPublisher.hpp"
 
 namespace enigma {
 namespace mqtt {
@@ -53,11 +59,36 @@ struct MQTTConfig {
  * @brief Helper function to start MQTT broker on a host
  * @param host Host to run broker on
  * @param broker_name Broker identifier
+ * @param config Broker options
  * @return Broker actor
  */
 inline simgrid::s4u::ActorPtr start_broker(simgrid::s4u::Host* host,
-                                           const std::string& broker_name = "mqtt_broker") {
-    return host->add_actor("mqtt_broker", MQTTBroker(broker_name));
+                                           const std::string& broker_name = "mqtt_broker",
+                                           const MQTTBrokerConfig& config = MQTTBrokerConfig()) {
+    return host->add_actor("mqtt_broker", MQTTBroker(broker_name, config));
+}
+
+/**
+ * @brief Helper function to stop a broker
+ * 
+ * The broker prints its statistics and, if MQTTStatsConfig::export_prefix
+ * is set, exports them before terminating.
+ * @param broker_name Broker identifier
+ */
+inline void stop_broker(const std::string& broker_name = "mqtt_broker") {
+    simgrid::s4u::Mailbox::by_name(MQTTBroker::get_broker_mailbox(broker_name))
+        ->put(MQTTControlMessage::shutdown(), MQTTWire::empty());
+}
+
+/**
+ * @brief Helper function to start an MQTT bridge on a host
+ * @param host Host to run the bridge on (usually the local broker's host)
+ * @param config Bridge configuration (brokers, rules, batching)
+ * @return Bridge actor
+ */
+inline simgrid::s4u::ActorPtr start_bridge(simgrid::s4u::Host* host,
+                                           const MQTTBridgeConfig& config) {
+    return host->add_actor("mqtt_bridge", MQTTBridge(config));
 }
 
 /**
@@ -0,0 +1,151 @@
+#ifndef ENIGMA_MQTT_BATCH_PUBLISHER_HPP
+#define ENIGMA_MQTT_BATCH_PUBLISHER_HPP
+
+#include "MQTTPublisher.hpp"
+#include <simgrid/s4u.hpp>
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+
+namespace enigma {
+namespace mqtt {
+
+/**
+ * @brief Auto-batching thresholds
+ */
+struct MQTTBatchConfig {
+    size_t max_messages;  // Flush once a batch holds this many messages
+    size_t max_bytes;     // Flush once a batch reaches this size (0 = unlimited)
+    double max_delay;     // Max time a message waits before being flushed (s)
+    
+    MQTTBatchConfig()
+        : max_messages(32),
+          max_bytes(0),
+          max_delay(0.1) {}
+};
+
+/**
+ * @brief Auto-batching statistics
+ */
+struct MQTTBatchStats {
+    int batches;                // Transfers sent
+    int messages;               // Messages sent in those transfers
+    size_t bytes;
+    size_t max_batch_messages;
+    size_t max_batch_bytes;
+    double total_added_latency; // Sum over messages of (flush time - publish time)
+    double max_added_latency;
+    int failed_batches;         // Of the batches above, lost because the broker was unreachable
+    int failed_messages;
+    
+    MQTTBatchStats()
+        : batches(0), messages(0), bytes(0), max_batch_messages(0), max_batch_bytes(0),
+          total_added_latency(0), max_added_latency(0), failed_batches(0),
+          failed_messages(0) {}
+};
+
+/**
+ * @brief Auto-batching MQTT Publisher (Nagle-style)
+ *
+ * publish() only appends the message to the batch of its destination
+ * broker and returns immediately. A flush actor started on the same host
+ * sends a batch as one PUBLISH_BATCH transfer once it reaches
+ * max_messages / max_bytes or its oldest message has waited max_delay.
+ *
+ * The flush actor owns the underlying MQTTPublisher(s), so QoS 1/2
+ * acknowledgements are handled there. close() (or the destructor) flushes
+ * what is left and stops the flush actor. A batch whose broker is unknown
+ * or does not answer the CONNECT is dropped and counted in failed_batches;
+ * the connection is attempted again for the next batch.
+ */
+class MQTTBatchPublisher {
+private:
+    struct Batch {
+        std::vector<std::shared_ptr<MQTTMessage>> messages;
+        size_t bytes = 0;
+        double oldest = 0;
+    };
+    
+    // State shared between the application actor and the flush actor
+    struct State {
+        std::string default_broker;
+        std::string publisher_id;
+        MQTTBatchConfig config;
+        std::map<std::string, Batch> batches;  // destination broker -> batch
+        MQTTBatchStats stats;
+        bool flush_requested = false;
+        bool closed = false;
+        bool finished = false;
+        simgrid::s4u::MutexPtr mutex;
+        simgrid::s4u::ConditionVariablePtr cond;
+    };
+    
+    std::shared_ptr<State> state;
+    
+public:
+    /**
+     * @brief Construct auto-batching publisher and start its flush actor
+     * @param broker Default broker to publish to
+     * @param pub_id Unique identifier for this publisher
+     * @param config Batching thresholds
+     */
+    MQTTBatchPublisher(const std::string& broker = "mqtt_broker",
+                       const std::string& pub_id = "",
+                       const MQTTBatchConfig& config = MQTTBatchConfig());
+    
+    ~MQTTBatchPublisher();
+    
+    MQTTBatchPublisher(const MQTTBatchPublisher&) = delete;
+    MQTTBatchPublisher& operator=(const MQTTBatchPublisher&) = delete;
+    
+    /**
+     * @brief Queue a message for the default broker
+     */
+    void publish(const std::string& topic,
+                 const std::string& payload,
+                 size_t size,
+                 int qos = 0);
+    
+    /**
+     * @brief Queue a message for a specific broker
+     */
+    void publish_to(const std::string& broker,
+                    const std::string& topic,
+                    const std::string& payload,
+                    size_t size,
+                    int qos = 0);
+    
+    /**
+     * @brief Ask the flush actor to send all pending batches now
+     */
+    void flush();
+    
+    /**
+     * @brief Flush pending batches and wait for the flush actor to stop
+     */
+    void close();
+    
+    /**
+     * @brief Get batching statistics
+     */
+    const MQTTBatchStats& get_stats() const { return state->stats; }
+    
+    /**
+     * @brief Log batching statistics
+     */
+    void print_stats() const;
+    
+    /**
+     * @brief Get publisher ID
+     */
+    const std::string& get_id() const { return state->publisher_id; }
+    
+private:
+    static void flush_loop(std::shared_ptr<State> state);
+};
+
+} // namespace mqtt
+} // namespace enigma
+
+#endif // ENIGMA_MQTT_BATCH_PUBLISHER_HPP
@@ -0,0 +1,132 @@
+#ifndef ENIGMA_MQTT_BRIDGE_HPP
+#define ENIGMA_MQTT_BRIDGE_HPP
+
+#include "MQTTBroker.hpp"
+#include <simgrid/s4u.hpp>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace enigma {
+namespace mqtt {
+
+/**
+ * @brief Forwarding rule of a bridge (mosquitto-style)
+ *
+ * The bridge subscribes to `local_prefix + topic` on the local broker and
+ * republishes every match on the remote broker with `local_prefix` replaced
+ * by `remote_prefix`.
+ */
+struct MQTTBridgeRule {
+    std::string topic;          // Topic filter, may contain '+' and '#'
+    std::string local_prefix;   // Prefix stripped from local topics
+    std::string remote_prefix;  // Prefix prepended to remote topics
+    
+    MQTTBridgeRule(const std::string& t,
+                   const std::string& local = "",
+                   const std::string& remote = "")
+        : topic(t), local_prefix(local), remote_prefix(remote) {}
+};
+
+/**
+ * @brief MQTT Bridge configuration options
+ */
+struct MQTTBridgeConfig {
+    std::string bridge_name;           // Bridge identifier (subscriber/publisher id)
+    std::string local_broker;          // Broker the bridge subscribes to
+    std::string remote_broker;         // Broker the bridge forwards to
+    std::vector<MQTTBridgeRule> rules; // Topics to forward upward
+    
+    size_t batch_max_messages;         // Flush after this many messages (<= 1 disables batching)
+    size_t batch_max_bytes;            // Flush once the batch reaches this size (0 = unlimited)
+    double batch_timeout;              // Max time a message waits in a batch (seconds)
+    int max_hops;                      // Drop messages bridged more often than this
+    double idle_timeout;               // Stop after this long without traffic (-1 = never)
+    
+    MQTTBridgeConfig()
+        : bridge_name("mqtt_bridge"),
+          local_broker("mqtt_broker"),
+          remote_broker("mqtt_broker_cloud"),
+          batch_max_messages(1),
+          batch_max_bytes(0),
+          batch_timeout(1.0),
+          max_hops(8),
+          idle_timeout(-1) {}
+    
+    static MQTTBridgeConfig create(const std::string& local,
+                                   const std::string& remote,
+                                   const std::string& topic = "#") {
+        MQTTBridgeConfig config;
+        config.bridge_name = "bridge_" + local + "_to_" + remote;
+        config.local_broker = local;
+        config.remote_broker = remote;
+        config.rules.emplace_back(topic);
+        return config;
+    }
+    
+    static MQTTBridgeConfig create_batched(const std::string& local,
+                                           const std::string& remote,
+                                           size_t max_messages,
+                                           double timeout,
+                                           const std::string& topic = "#") {
+        MQTTBridgeConfig config = create(local, remote, topic);
+        config.batch_max_messages = max_messages;
+        config.batch_timeout = timeout;
+        return config;
+    }
+};
+
+/**
+ * @brief MQTT Bridge - Forwards selected topics from one broker to another
+ *
+ * Runs as a SimGrid actor, typically on the host of the local (edge/fog)
+ * broker. Messages can be coalesced into batches so that a single transfer
+ * crosses the WAN link instead of one per message. Every forwarded message
+ * records the brokers it traversed in MQTTMessage::via; a message is never
+ * sent back to a broker it already visited, which prevents loops between
+ * bidirectional bridge pairs.
+ */
+class MQTTBridge {
+private:
+    MQTTBridgeConfig config;
+    simgrid::s4u::Mailbox* remote_mbox;
+    
+    std::vector<std::shared_ptr<MQTTMessage>> pending;
+    size_t pending_bytes;
+    double pending_since;
+    
+    // Statistics
+    int messages_received;
+    int messages_forwarded;
+    int messages_dropped_loop;
+    int transfers;
+    size_t bytes_forwarded;
+    
+public:
+    /**
+     * @brief Construct MQTT Bridge
+     * @param cfg Bridge configuration (brokers, rules, batching)
+     */
+    explicit MQTTBridge(const MQTTBridgeConfig& cfg);
+    
+    /**
+     * @brief Main bridge loop - SimGrid actor operator
+     */
+    void operator()();
+    
+    /**
+     * @brief Get statistics
+     */
+    void print_stats() const;
+    
+private:
+    void handle_message(const std::shared_ptr<MQTTMessage>& msg);
+    void forward(std::shared_ptr<MQTTMessage> msg);
+    void flush();
+    const MQTTBridgeRule* find_rule(const std::string& topic) const;
+};
+
+} // namespace mqtt
+} // namespace enigma
+
+#endif // ENIGMA_MQTT_BRIDGE_HPP
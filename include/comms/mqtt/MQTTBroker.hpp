@@ -1,9 +1,14 @@
 #ifndef ENIGMA_MQTT_BROKER_HPP
 #define ENIGMA_MQTT_BROKER_HPP
 
+#include "MQTTStats.hpp"
+#include "MQTTOperator.hpp"
+#include "MQTTWire.hpp"
 #include <simgrid/s4u.hpp>
 #include <string>
 #include <map>
+#include <set>
+#include <deque>
 #include <vector>
 #include <memory>
 
@@ -20,14 +25,195 @@ struct MQTTMessage {
     double timestamp;
     std::string publisher;
     int qos;  // Quality of Service (0, 1, 2)
+    std::vector<std::string> via;  // Brokers this message was bridged through
+    size_t properties;  // MQTT 5 property bytes (user properties, content type, ...)
+    bool retain;  // Kept by the broker as the last value of the topic
+    
+    // Payload compression (size is the compressed size)
+    std::string codec;         // "" = uncompressed
+    size_t uncompressed_size;
+    double decompress_cost;    // Flops to decompress at the subscriber
     
     MQTTMessage(const std::string& t, const std::string& p, size_t s, 
                 const std::string& pub, int q = 0)
-        : topic(t), payload(p), size(s), publisher(pub), qos(q) {
+        : topic(t), payload(p), size(s), publisher(pub), qos(q), properties(0),
+          retain(false), uncompressed_size(s), decompress_cost(0) {
         timestamp = simgrid::s4u::Engine::get_clock();
     }
 };
 
+/**
+ * @brief A message as handed to one subscriber
+ * 
+ * Packet identifiers and the granted QoS are per hop, so the broker wraps
+ * the shared MQTTMessage in a delivery envelope for every subscriber.
+ */
+struct MQTTDelivery {
+    std::shared_ptr<MQTTMessage> message;
+    int qos;        // QoS granted on the broker -> subscriber hop
+    int packet_id;  // 0 for QoS 0
+    bool dup;       // Retransmission of an unacknowledged delivery
+    
+    MQTTDelivery(std::shared_ptr<MQTTMessage> m, int q = 0, int id = 0, bool d = false)
+        : message(std::move(m)), qos(q), packet_id(id), dup(d) {}
+    
+    /**
+     * @brief Size of the PUBLISH packet carrying this delivery
+     */
+    size_t wire_size() const {
+        return MQTTWire::publish(message->topic.size(), message->size, packet_id != 0,
+                                 message->properties);
+    }
+};
+
+/**
+ * @brief QoS 1/2 flow control options (shared by broker and clients)
+ */
+struct MQTTQoSConfig {
+    size_t max_inflight;        // Unacknowledged QoS 1/2 packets allowed per peer (0 = unlimited)
+    double retransmit_timeout;  // Resend unacknowledged packets after this delay (s)
+    
+    MQTTQoSConfig()
+        : max_inflight(20),
+          retransmit_timeout(10.0) {}
+    
+    /**
+     * @brief Whether @p inflight unacknowledged packets fill the window
+     */
+    bool window_full(size_t inflight) const {
+        return max_inflight > 0 && inflight >= max_inflight;
+    }
+};
+
+/**
+ * @brief What the broker does when a subscriber queue is full
+ */
+enum class MQTTOverflowPolicy {
+    BLOCK,        // Wait until the subscriber catches up (stalls the broker)
+    DROP_OLDEST,  // Discard the oldest queued message
+    DROP_NEWEST,  // Discard the incoming message
+    DISCONNECT    // Drop the subscriber and all its subscriptions
+};
+
+/**
+ * @brief Per-subscriber delivery queue options
+ */
+struct MQTTQueueConfig {
+    size_t capacity;            // Messages queued per subscriber (0 = unbounded)
+    MQTTOverflowPolicy policy;  // Applied when the queue is full
+    
+    MQTTQueueConfig(size_t cap = 1000, MQTTOverflowPolicy pol = MQTTOverflowPolicy::BLOCK)
+        : capacity(cap), policy(pol) {}
+};
+
+/**
+ * @brief How a shared subscription picks the group member for a message
+ */
+enum class MQTTShareStrategy {
+    ROUND_ROBIN,        // Members take turns
+    LEAST_QUEUE_DEPTH,  // Member with the fewest queued / unacknowledged messages
+    HASH_PUBLISHER      // Same publisher always goes to the same member
+};
+
+/**
+ * @brief CPU cost of broker work, executed on the broker host
+ * 
+ * Costs are in flops, so the same workload saturates a slow edge gateway
+ * long before a cloud server. All costs default to 0 (infinitely fast
+ * broker).
+ */
+struct MQTTServiceConfig {
+    double cost_per_message;   // Any control message (publish, subscribe, ack, ...)
+    double cost_per_byte;      // Per payload byte of a published message
+    double cost_per_match;     // Per filter evaluated (wildcard filters + 1 exact lookup)
+    double cost_per_delivery;  // Per subscriber a message is fanned out to
+    int workers;               // Publish workers (capped at the host core count)
+    
+    MQTTServiceConfig()
+        : cost_per_message(0),
+          cost_per_byte(0),
+          cost_per_match(0),
+          cost_per_delivery(0),
+          workers(1) {}
+};
+
+/**
+ * @brief What the broker does when stored messages exceed the memory budget
+ */
+enum class MQTTEvictionPolicy {
+    EVICT_OLDEST,  // Discard the oldest stored message (retained or offline)
+    REJECT_NEW     // Keep what is stored, do not store the incoming message
+};
+
+/**
+ * @brief Retained messages and offline sessions
+ * 
+ * Stored bytes are the topic and payload bytes of retained messages plus
+ * those of messages queued for disconnected persistent sessions.
+ */
+struct MQTTStorageConfig {
+    size_t memory_budget;         // Bytes of stored messages (0 = unlimited)
+    MQTTEvictionPolicy eviction;  // Applied when the budget is exceeded
+    
+    MQTTStorageConfig(size_t budget = 0,
+                      MQTTEvictionPolicy ev = MQTTEvictionPolicy::EVICT_OLDEST)
+        : memory_budget(budget), eviction(ev) {}
+};
+
+/**
+ * @brief What the broker does with a publish that exceeds its rate limit
+ */
+enum class MQTTRateLimitAction {
+    REJECT,  // Drop the message (QoS 1/2 publishes are still acknowledged)
+    DELAY    // Hold the message until a token is available (routing goes on)
+};
+
+/**
+ * @brief Token bucket: @p rate messages per second, bursts of up to @p burst
+ */
+struct MQTTRateLimit {
+    double rate;   // Tokens per second (0 = unlimited)
+    double burst;  // Bucket size (messages)
+    MQTTRateLimitAction action;
+    
+    MQTTRateLimit(double r = 0, double b = 1,
+                  MQTTRateLimitAction a = MQTTRateLimitAction::REJECT)
+        : rate(r), burst(b), action(a) {}
+};
+
+/**
+ * @brief Admission control on published messages
+ * 
+ * A publish must take a token from the bucket of its publisher and from
+ * the bucket of its topic for every matching topic limit.
+ */
+struct MQTTRateLimitConfig {
+    MQTTRateLimit per_publisher;  // Default bucket of every publisher
+    std::map<std::string, MQTTRateLimit> publisher_overrides;  // Per publisher id
+    std::map<std::string, MQTTRateLimit> topics;  // Topic filter -> bucket per topic
+};
+
+/**
+ * @brief MQTT Broker configuration options
+ */
+struct MQTTBrokerConfig {
+    MQTTQoSConfig qos;      // Broker -> subscriber in-flight window
+    MQTTQueueConfig queue;  // Default subscriber queue
+    std::map<std::string, MQTTQueueConfig> queue_overrides;  // Per subscriber id
+    MQTTStatsConfig stats;  // Latency / throughput collection and export
+    MQTTServiceConfig service;  // CPU service-time model
+    MQTTShareStrategy share_strategy;  // Shared subscriptions ($share/group/filter)
+    std::map<std::string, MQTTShareStrategy> share_overrides;  // Per group name
+    MQTTStorageConfig storage;  // Retained messages and offline sessions
+    std::vector<MQTTOperatorConfig> operators;  // Stream operators on published topics
+    MQTTRateLimitConfig rate_limits;  // Per-publisher / per-topic token buckets
+    
+    MQTTBrokerConfig()
+        : share_strategy(MQTTShareStrategy::ROUND_ROBIN) {}
+};
+
+struct MQTTControlMessage;
+
 /**
  * @brief MQTT Broker - Central message broker for pub/sub
  * 
@@ -36,15 +222,128 @@ struct MQTTMessage {
  */
 class MQTTBroker {
 private:
+    struct Subscription {
+        std::string subscriber;
+        int qos;  // Maximum QoS granted to this subscriber
+    };
+    
+    // Outstanding QoS 1/2 delivery towards a subscriber
+    struct InFlight {
+        MQTTDelivery delivery;
+        bool released;   // QoS 2: PUBREC received, PUBREL sent
+        double sent_at;
+    };
+    
+    // Per-subscriber QoS state
+    struct Session {
+        int next_packet_id = 1;
+        std::map<int, InFlight> inflight;
+        std::deque<MQTTDelivery> pending;  // Waiting for in-flight window
+        
+        // Persistent session (client connected with clean_start = false)
+        bool persistent = false;
+        bool offline = false;
+        std::deque<MQTTDelivery> stored;  // Queued while offline
+    };
+    
+    // Bounded delivery queue towards one subscriber, drained by an egress
+    // actor so that a slow subscriber only stalls its own queue
+    struct Outbox {
+        std::string subscriber;
+        MQTTQueueConfig config;
+        std::deque<MQTTDelivery> queue;
+        bool closed = false;
+        bool disconnected = false;  // Overflowed under DISCONNECT policy
+        simgrid::s4u::MutexPtr mutex;
+        simgrid::s4u::ConditionVariablePtr cond;
+        
+        std::shared_ptr<MQTTBrokerStats> stats;  // Shared with the broker
+        
+        // Statistics
+        int enqueued = 0;
+        int delivered = 0;
+        int dropped = 0;
+        size_t max_depth = 0;
+    };
+    
+    struct TokenBucket {
+        double tokens;
+        double updated;  // Time of the last refill
+    };
+    
+    // Publishes waiting for one worker actor
+    struct WorkQueue {
+        std::deque<MQTTControlMessage*> messages;
+        bool closed = false;
+        simgrid::s4u::MutexPtr mutex;
+        simgrid::s4u::ConditionVariablePtr cond;
+    };
+    
     std::string broker_name;
+    MQTTBrokerConfig config;
     simgrid::s4u::Mailbox* control_mbox;
     
-    // Topic subscriptions: topic -> list of subscriber mailboxes
-    std::map<std::string, std::vector<std::string>> subscriptions;
+    // Broker state below is shared by the main actor and the workers.
+    // Actors only switch at blocking calls (charge(), a full queue under
+    // BLOCK), so state is read and updated between them and never through
+    // a reference or iterator held across one: the client may be removed
+    // while the caller is blocked.
+    
+    // Topic subscriptions: topic filter -> subscribers
+    std::map<std::string, std::vector<Subscription>> subscriptions;
+    
+    // Filters of `subscriptions` with wildcards or a $share prefix; the
+    // others are found by an exact lookup of the published topic
+    std::set<std::string> pattern_filters;
+    
+    std::map<std::string, Session> sessions;
+    std::map<std::string, std::shared_ptr<Outbox>> outboxes;
+    std::vector<std::string> pending_disconnects;
+    
+    // Shared subscriptions: filter -> next member, filter -> member -> deliveries
+    std::map<std::string, size_t> share_cursors;
+    std::map<std::string, std::map<std::string, int>> share_deliveries;
+    
+    std::vector<MQTTStreamOperator> operators;
+    
+    // Rate limiting: publisher -> bucket, (topic filter, topic) -> bucket
+    std::map<std::string, TokenBucket> publisher_buckets;
+    std::map<std::pair<std::string, std::string>, TokenBucket> topic_buckets;
+    std::map<std::string, int> throttled_publishers;  // Publisher -> throttled messages
+    
+    // Delayed publishes: publisher -> (release time, message), in publish order
+    std::map<std::string, std::deque<std::pair<double, std::shared_ptr<MQTTMessage>>>> held;
+    
+    std::vector<std::shared_ptr<WorkQueue>> work_queues;
+    std::vector<simgrid::s4u::ActorPtr> workers;
+    
+    std::set<std::string> connected_clients;
+    
+    // QoS 2 publishes received but not yet released: (client, packet id)
+    std::set<std::pair<std::string, int>> qos2_received;
+    
+    // Retained messages: topic -> last retained message
+    std::map<std::string, std::shared_ptr<MQTTMessage>> retained;
+    size_t stored_bytes;  // Retained + offline session messages
     
     // Statistics
     int messages_published;
-    int messages_delivered;
+    int duplicates_suppressed;
+    int retransmissions;
+    int subscribers_disconnected;
+    int connects;
+    int pings;
+    int messages_stored;     // Queued for offline sessions
+    int messages_replayed;   // Handed out when a session resumed
+    int storage_evictions;
+    int storage_rejected;
+    size_t max_stored_bytes;
+    int messages_rate_rejected;
+    int messages_rate_delayed;
+    double rate_delay;  // Total time publishes were held by rate limits
+    double busy_time;  // Simulated time spent executing service costs
+    std::shared_ptr<MQTTBrokerStats> traffic_stats;
+    double last_depth_sample;
     
     bool running;
     
@@ -52,8 +351,10 @@ public:
     /**
      * @brief Construct MQTT Broker
      * @param name Broker name (used for mailbox identification)
+     * @param cfg Broker options
      */
-    explicit MQTTBroker(const std::string& name = "mqtt_broker");
+    explicit MQTTBroker(const std::string& name = "mqtt_broker",
+                        const MQTTBrokerConfig& cfg = MQTTBrokerConfig());
     
     /**
      * @brief Main broker loop - SimGrid actor operator
@@ -71,15 +372,92 @@ public:
     static std::string get_topic_mailbox(const std::string& broker_name,
                                          const std::string& topic);
     
+    /**
+     * @brief Get the mailbox a client receives acknowledgements on
+     */
+    static std::string get_client_mailbox(const std::string& client_id);
+    
+    /**
+     * @brief Match a topic against a subscription filter
+     * 
+     * Supports the MQTT wildcards '+' (exactly one level) and '#'
+     * (all remaining levels, must be the last level of the filter).
+     * A shared subscription ($share/group/filter) matches like its filter.
+     */
+    static bool topic_matches(const std::string& filter, const std::string& topic);
+    
+    /**
+     * @brief Split a shared subscription "$share/group/filter"
+     * @return false if the filter is not a shared subscription
+     */
+    static bool parse_shared_subscription(const std::string& filter,
+                                          std::string& group,
+                                          std::string& topic_filter);
+    
     /**
      * @brief Get statistics
      */
     void print_stats() const;
     
 private:
-    void handle_subscribe(const std::string& topic, const std::string& subscriber);
+    void handle_control(const MQTTControlMessage& ctrl_msg);
+    void handle_connect(const std::string& client, bool clean_start);
+    void handle_disconnect(const std::string& client);
+    void handle_subscribe(const std::string& topic, const std::string& subscriber, int qos);
     void handle_unsubscribe(const std::string& topic, const std::string& subscriber);
-    void handle_publish(std::shared_ptr<MQTTMessage> msg);
+    void handle_publish(std::shared_ptr<MQTTMessage> msg,
+                        const std::string& client = "", int packet_id = 0);
+    static bool is_pattern(const std::string& filter);
+    void erase_filter(std::map<std::string, std::vector<Subscription>>::iterator it);
+    bool admit(const MQTTMessage& msg, double& release_at);
+    void accept(std::shared_ptr<MQTTMessage> msg);
+    void hold(std::shared_ptr<MQTTMessage> msg, double release_at);
+    void release_held();
+    double next_held_deadline() const;
+    void route(std::shared_ptr<MQTTMessage> msg);
+    void handle_pubrel(const std::string& client, int packet_id);
+    void handle_subscriber_ack(const MQTTControlMessage& ack);
+    void charge(double flops);
+    
+    bool apply_operators(const std::shared_ptr<MQTTMessage>& msg);
+    void flush_operators();
+    void publish_derived(const std::vector<std::shared_ptr<MQTTMessage>>& derived);
+    double next_operator_deadline() const;
+    
+    void start_workers();
+    void stop_workers();
+    void dispatch(MQTTControlMessage* ctrl_msg);
+    void worker_loop(std::shared_ptr<WorkQueue> queue);
+    
+    const Subscription& select_shared(const std::string& filter,
+                                      const std::vector<Subscription>& members,
+                                      const MQTTMessage& msg);
+    size_t subscriber_backlog(const std::string& subscriber) const;
+    
+    void deliver(const std::string& subscriber, std::shared_ptr<MQTTMessage> msg, int qos);
+    void send_delivery(const std::string& subscriber, const MQTTDelivery& delivery);
+    void send_pending(const std::string& subscriber);
+    void send_to_client(const std::string& client, MQTTControlMessage* msg);
+    
+    void store_retained(std::shared_ptr<MQTTMessage> msg);
+    void send_retained(const std::string& filter, const std::string& subscriber, int qos);
+    void store_offline(Session& session, const MQTTDelivery& delivery);
+    void resume_session(const std::string& client);
+    bool reserve_storage(size_t bytes);
+    bool evict_oldest();
+    void remove_client(const std::string& client);
+    static size_t stored_size(const MQTTMessage& msg);
+    
+    std::shared_ptr<Outbox> get_outbox(const std::string& subscriber);
+    std::shared_ptr<Outbox> open_outbox(const std::string& subscriber);
+    void process_disconnects();
+    void sample_queue_depth();
+    void export_stats() const;
+    void close_outboxes();
+    static void egress_loop(std::shared_ptr<Outbox> outbox);
+    
+    double next_retransmit_deadline() const;
+    void retransmit_expired();
 };
 
 /**
@@ -87,9 +465,18 @@ private:
  */
 struct MQTTControlMessage {
     enum class Type {
+        CONNECT,
+        CONNACK,
         SUBSCRIBE,
         UNSUBSCRIBE,
         PUBLISH,
+        PUBLISH_BATCH,
+        PUBACK,   // QoS 1: delivery acknowledged
+        PUBREC,   // QoS 2 step 1: publish received
+        PUBREL,   // QoS 2 step 2: publish released
+        PUBCOMP,  // QoS 2 step 3: release complete
+        PINGREQ,  // Keepalive
+        PINGRESP,
         DISCONNECT,
         SHUTDOWN
     };
@@ -98,14 +485,50 @@ struct MQTTControlMessage {
     std::string topic;
     std::string subscriber;
     std::shared_ptr<MQTTMessage> message;
+    std::vector<std::shared_ptr<MQTTMessage>> batch;  // PUBLISH_BATCH only
+    std::string client;   // Sender to acknowledge (empty = no acknowledgement)
+    int qos;              // SUBSCRIBE: requested maximum QoS
+    int packet_id;        // PUBLISH (QoS > 0) and acknowledgements
+    std::vector<int> packet_ids;  // PUBLISH_BATCH: one id per message (0 = QoS 0)
+    bool dup;             // PUBLISH retransmission
+    bool clean_start;     // CONNECT: discard any previous session
+    bool session_present; // CONNACK: a persistent session was resumed
+    
+    MQTTControlMessage(Type t)
+        : type(t), qos(0), packet_id(0), dup(false), clean_start(true),
+          session_present(false) {}
     
-    MQTTControlMessage(Type t) : type(t) {}
+    /**
+     * @brief Size of the corresponding MQTT packet(s) on the wire
+     */
+    size_t wire_size() const;
+    
+    static MQTTControlMessage* connect(const std::string& client, bool clean_start = true) {
+        auto* msg = new MQTTControlMessage(Type::CONNECT);
+        msg->client = client;
+        msg->clean_start = clean_start;
+        return msg;
+    }
+    
+    static MQTTControlMessage* ping(const std::string& client) {
+        auto* msg = new MQTTControlMessage(Type::PINGREQ);
+        msg->client = client;
+        return msg;
+    }
+    
+    static MQTTControlMessage* disconnect(const std::string& client) {
+        auto* msg = new MQTTControlMessage(Type::DISCONNECT);
+        msg->client = client;
+        return msg;
+    }
     
     static MQTTControlMessage* subscribe(const std::string& topic, 
-                                         const std::string& subscriber) {
+                                         const std::string& subscriber,
+                                         int qos = 0) {
         auto* msg = new MQTTControlMessage(Type::SUBSCRIBE);
         msg->topic = topic;
         msg->subscriber = subscriber;
+        msg->qos = qos;
         return msg;
     }
     
@@ -117,9 +540,32 @@ struct MQTTControlMessage {
         return msg;
     }
     
-    static MQTTControlMessage* publish(std::shared_ptr<MQTTMessage> mqtt_msg) {
+    static MQTTControlMessage* publish(std::shared_ptr<MQTTMessage> mqtt_msg,
+                                       const std::string& client = "",
+                                       int packet_id = 0,
+                                       bool dup = false) {
         auto* msg = new MQTTControlMessage(Type::PUBLISH);
         msg->message = mqtt_msg;
+        msg->client = client;
+        msg->packet_id = packet_id;
+        msg->dup = dup;
+        return msg;
+    }
+    
+    static MQTTControlMessage* publish_batch(std::vector<std::shared_ptr<MQTTMessage>> msgs,
+                                             const std::string& client = "",
+                                             std::vector<int> packet_ids = {}) {
+        auto* msg = new MQTTControlMessage(Type::PUBLISH_BATCH);
+        msg->batch = std::move(msgs);
+        msg->client = client;
+        msg->packet_ids = std::move(packet_ids);
+        return msg;
+    }
+    
+    static MQTTControlMessage* ack(Type t, const std::string& client, int packet_id) {
+        auto* msg = new MQTTControlMessage(t);
+        msg->client = client;
+        msg->packet_id = packet_id;
         return msg;
     }
     
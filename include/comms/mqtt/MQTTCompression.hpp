@@ -0,0 +1,89 @@
+#ifndef ENIGMA_MQTT_COMPRESSION_HPP
+#define ENIGMA_MQTT_COMPRESSION_HPP
+
+#include <string>
+#include <cmath>
+#include <stdexcept>
+
+namespace enigma {
+namespace mqtt {
+
+struct MQTTMessage;
+
+/**
+ * @brief Payload compression profile
+ *
+ * Costs are in flops per uncompressed byte and are executed on the
+ * publisher (compression) and subscriber (decompression) hosts. The
+ * built-in profiles are typical figures for sensor and log payloads at
+ * default compression levels, expressed as roughly one flop per CPU cycle:
+ * LZ4 is fast with a moderate ratio, gzip compresses best but costs an
+ * order of magnitude more CPU, zstd sits in between.
+ */
+struct MQTTCodec {
+    std::string name;
+    double ratio;            // Compressed / uncompressed payload size
+    double compress_cost;    // Flops per uncompressed byte
+    double decompress_cost;  // Flops per uncompressed byte
+    size_t header;           // Frame overhead per message (bytes)
+    
+    MQTTCodec(const std::string& n = "none", double r = 1.0, double c = 0, double d = 0,
+              size_t h = 0)
+        : name(n), ratio(r), compress_cost(c), decompress_cost(d), header(h) {}
+    
+    bool enabled() const { return name != "none"; }
+    
+    /**
+     * @brief Payload size after compression (never less than the header)
+     */
+    size_t compressed_size(size_t size) const {
+        return header + static_cast<size_t>(std::ceil(static_cast<double>(size) * ratio));
+    }
+    
+    static MQTTCodec none() { return MQTTCodec(); }
+    static MQTTCodec lz4()  { return MQTTCodec("lz4", 0.50, 5.0, 1.0, 8); }
+    static MQTTCodec zstd() { return MQTTCodec("zstd", 0.35, 15.0, 3.0, 9); }
+    static MQTTCodec gzip() { return MQTTCodec("gzip", 0.32, 60.0, 8.0, 18); }
+    
+    /**
+     * @brief Built-in profile by name ("none", "lz4", "zstd", "gzip")
+     * @throws std::invalid_argument for an unknown name
+     */
+    static MQTTCodec by_name(const std::string& name) {
+        if (name == "none") return none();
+        if (name == "lz4")  return lz4();
+        if (name == "zstd") return zstd();
+        if (name == "gzip") return gzip();
+        throw std::invalid_argument("Unknown codec '" + name + "'");
+    }
+};
+
+/**
+ * @brief Compression counters kept by the publishers
+ */
+struct MQTTCompressionStats {
+    int messages_compressed;
+    size_t payload_bytes_in;    // Payload bytes before compression
+    size_t payload_bytes_out;   // Payload bytes after compression
+    double compression_time;    // Time spent compressing (s)
+    
+    MQTTCompressionStats()
+        : messages_compressed(0), payload_bytes_in(0), payload_bytes_out(0),
+          compression_time(0) {}
+};
+
+/**
+ * @brief Compress a message on the calling actor's host
+ * 
+ * Executes the codec's compression cost, rewrites the message size to the
+ * compressed size and records the decompression cost the receiver pays.
+ * Messages already compressed or smaller than @p min_size are left as is.
+ * @return True if the message was compressed
+ */
+bool compress_message(const MQTTCodec& codec, size_t min_size, MQTTMessage& msg,
+                      MQTTCompressionStats& stats);
+
+} // namespace mqtt
+} // namespace enigma
+
+#endif // ENIGMA_MQTT_COMPRESSION_HPP
@@ -0,0 +1,81 @@
+#ifndef ENIGMA_MQTT_DISPATCHER_HPP
+#define ENIGMA_MQTT_DISPATCHER_HPP
+
+#include "MQTTBroker.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+namespace enigma {
+namespace mqtt {
+
+/**
+ * @brief Callback invoked by a subscriber's run() for a matching message
+ */
+using MQTTMessageHandler = std::function<void(const std::shared_ptr<MQTTMessage>&)>;
+
+/**
+ * @brief Receiving side shared by the subscribers of every transport
+ * 
+ * Holds the on_message() handler table and runs the dispatch loop over a
+ * transport's receive_batch(). Also pays the decompression cost of
+ * compressed payloads on the receiving host.
+ */
+class MQTTDispatcher {
+public:
+    /**
+     * @brief Transport receive step: up to max_n messages, waiting at most timeout
+     */
+    using BatchReceiver = std::function<std::vector<std::shared_ptr<MQTTMessage>>(size_t max_n,
+                                                                                  double timeout)>;
+    
+private:
+    // Topic filter -> callback
+    std::vector<std::pair<std::string, MQTTMessageHandler>> handlers;
+    bool running;
+    
+    int messages_decompressed;
+    double decompression_time;
+    
+public:
+    MQTTDispatcher();
+    
+    /**
+     * @brief Register a handler for messages matching a topic filter
+     */
+    void on_message(const std::string& topic_filter, MQTTMessageHandler handler);
+    
+    /**
+     * @brief Dispatch loop: receive message batches and call the handlers
+     * @param receive_batch Transport receive step
+     * @param idle_timeout Stop after this long without messages (-1 for infinite)
+     * @param max_messages Stop after this many messages (0 for unlimited)
+     * @return Number of messages dispatched
+     */
+    size_t run(const BatchReceiver& receive_batch, double idle_timeout, size_t max_messages);
+    
+    /**
+     * @brief Make run() return after the current batch
+     */
+    void stop() { running = false; }
+    
+    /**
+     * @brief Call every handler whose filter matches the message topic
+     */
+    void dispatch(const std::shared_ptr<MQTTMessage>& msg);
+    
+    /**
+     * @brief Execute the decompression cost of a compressed payload
+     */
+    void decompress(const MQTTMessage& msg);
+    
+    int get_messages_decompressed() const { return messages_decompressed; }
+    
+    double get_decompression_time() const { return decompression_time; }
+};
+
+} // namespace mqtt
+} // namespace enigma
+
+#endif // ENIGMA_MQTT_DISPATCHER_HPP
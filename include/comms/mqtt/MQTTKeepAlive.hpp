@@ -0,0 +1,63 @@
+#ifndef ENIGMA_MQTT_KEEPALIVE_HPP
+#define ENIGMA_MQTT_KEEPALIVE_HPP
+
+#include <simgrid/s4u.hpp>
+#include <string>
+#include <memory>
+
+namespace enigma {
+namespace mqtt {
+
+/**
+ * @brief Client keepalive: sends PINGREQ when a connection has been idle
+ *
+ * start() launches a daemon pinger actor on the client's host. It sends a
+ * PINGREQ to the broker whenever no other packet was sent for a full
+ * interval. The pinger stops once the last copy of the owning client is
+ * destroyed. Note that an active pinger keeps simulated time advancing, so
+ * clients blocked forever should not enable keepalive.
+ */
+class MQTTKeepAlive {
+private:
+    struct State {
+        std::string client_id;
+        simgrid::s4u::Mailbox* broker_mbox;
+        double interval;
+        double last_activity;
+        int pings_sent = 0;
+    };
+    
+    std::shared_ptr<State> state;
+    
+public:
+    /**
+     * @brief Start pinging
+     * @param client_id Client sending the PINGREQs
+     * @param broker_mbox Control mailbox of the broker
+     * @param interval Keepalive interval in seconds (<= 0 disables)
+     */
+    void start(const std::string& client_id, simgrid::s4u::Mailbox* broker_mbox,
+               double interval);
+    
+    /**
+     * @brief Record that the client sent a packet (resets the idle timer)
+     */
+    void touch() {
+        if (state) {
+            state->last_activity = simgrid::s4u::Engine::get_clock();
+        }
+    }
+    
+    /**
+     * @brief Number of PINGREQ packets sent
+     */
+    int get_pings_sent() const { return state ? state->pings_sent : 0; }
+    
+private:
+    static void ping_loop(std::weak_ptr<State> weak_state);
+};
+
+} // namespace mqtt
+} // namespace enigma
+
+#endif // ENIGMA_MQTT_KEEPALIVE_HPP
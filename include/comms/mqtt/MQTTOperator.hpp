@@ -0,0 +1,128 @@
+#ifndef ENIGMA_MQTT_OPERATOR_HPP
+#define ENIGMA_MQTT_OPERATOR_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace enigma {
+namespace mqtt {
+
+struct MQTTMessage;
+
+/**
+ * @brief Function computed by a broker stream operator
+ */
+enum class MQTTOperatorType {
+    COUNT,      // Messages per window
+    MEAN,       // Mean value per window
+    MIN,        // Minimum value per window
+    MAX,        // Maximum value per window
+    DEADBAND,   // Forward only when the value changed by at least `deadband`
+    DOWNSAMPLE  // Forward at most one message per `window` seconds
+};
+
+/**
+ * @brief Stream operator attached to a topic filter of a broker
+ *
+ * Windowed operators (COUNT, MEAN, MIN, MAX) use tumbling windows of
+ * `window` seconds aligned to multiples of the window, one per input topic,
+ * and publish one message per window on the derived topic. Values are read
+ * from the start of the payload; messages without a number are ignored.
+ */
+struct MQTTOperatorConfig {
+    std::string name;
+    std::string filter;         // Input topic filter (wildcards allowed)
+    MQTTOperatorType type;
+    double window;              // Window (s) of aggregates, min. interval of DOWNSAMPLE
+    double deadband;            // DEADBAND: minimum change to forward
+    std::string output_prefix;  // Derived topic = prefix + input topic ("" = "<name>/")
+    bool consume;               // Do not route matching input to subscribers
+    double cost_per_message;    // Flops per input message
+    
+    MQTTOperatorConfig(const std::string& n = "", const std::string& f = "#",
+                       MQTTOperatorType t = MQTTOperatorType::MEAN, double w = 1.0)
+        : name(n), filter(f), type(t), window(w), deadband(0), output_prefix(""),
+          consume(false), cost_per_message(0) {}
+};
+
+/**
+ * @brief Input / output traffic of one operator (MQTT wire bytes)
+ */
+struct MQTTOperatorStats {
+    int messages_in = 0;
+    size_t bytes_in = 0;
+    int messages_out = 0;
+    size_t bytes_out = 0;
+    int unparsable = 0;  // Input without a numeric value
+};
+
+/**
+ * @brief State of one stream operator
+ *
+ * Runs inside the broker actor; the broker charges the CPU cost and routes
+ * the derived messages.
+ */
+class MQTTStreamOperator {
+public:
+    /**
+     * @throws std::invalid_argument for a windowed operator without a window
+     */
+    explicit MQTTStreamOperator(const MQTTOperatorConfig& cfg);
+    
+    bool matches(const std::string& topic) const;
+    
+    /**
+     * @brief Feed one input message
+     * @param out Derived messages to publish are appended here
+     */
+    void process(const std::shared_ptr<MQTTMessage>& msg, double now,
+                 std::vector<std::shared_ptr<MQTTMessage>>& out);
+    
+    /**
+     * @brief Close the windows that ended by @p now
+     */
+    void flush(double now, std::vector<std::shared_ptr<MQTTMessage>>& out);
+    
+    /**
+     * @brief End of the earliest open window (infinity if none)
+     */
+    double next_deadline() const;
+    
+    const MQTTOperatorConfig& get_config() const { return config; }
+    const MQTTOperatorStats& get_stats() const { return stats; }
+    
+    void print() const;
+    
+private:
+    struct Window {
+        double end;
+        uint64_t count;
+        double sum;
+        double min;
+        double max;
+    };
+    
+    MQTTOperatorConfig config;
+    MQTTOperatorStats stats;
+    
+    std::map<std::string, Window> windows;       // Per input topic
+    std::map<std::string, double> last_value;    // DEADBAND
+    std::map<std::string, double> last_forward;  // DOWNSAMPLE
+    
+    bool is_windowed() const;
+    std::string derived_topic(const std::string& topic) const;
+    void emit(const std::string& topic, const Window& window,
+              std::vector<std::shared_ptr<MQTTMessage>>& out);
+    void forward(const std::shared_ptr<MQTTMessage>& msg,
+                 std::vector<std::shared_ptr<MQTTMessage>>& out);
+    void add_output(std::shared_ptr<MQTTMessage> msg,
+                    std::vector<std::shared_ptr<MQTTMessage>>& out);
+};
+
+} // namespace mqtt
+} // namespace enigma
+
+#endif // ENIGMA_MQTT_OPERATOR_HPP
@@ -2,31 +2,81 @@
 #define ENIGMA_MQTT_PUBLISHER_HPP
 
 #include "MQTTBroker.hpp"
+#include "MQTTKeepAlive.hpp"
+#include "MQTTCompression.hpp"
 #include <simgrid/s4u.hpp>
 #include <string>
+#include <map>
+#include <vector>
 
 namespace enigma {
 namespace mqtt {
 
+/**
+ * @brief Publisher-side QoS statistics
+ */
+struct MQTTPublisherStats : MQTTCompressionStats {
+    int messages_sent;          // Messages published (first transmissions)
+    int transfers;              // PUBLISH / PUBLISH_BATCH transfers to the broker
+    int messages_acknowledged;  // QoS 1/2 flows completed
+    int retransmissions;        // PUBLISH/PUBREL resent after a timeout
+    size_t bytes_sent;          // MQTT packet bytes sent to the broker (all packet types)
+    double total_ack_latency;   // Sum of PUBLISH -> PUBACK/PUBCOMP delays (s)
+    double max_ack_latency;
+    
+    MQTTPublisherStats()
+        : messages_sent(0), transfers(0), messages_acknowledged(0), retransmissions(0),
+          bytes_sent(0), total_ack_latency(0), max_ack_latency(0) {}
+};
+
 /**
  * @brief MQTT Publisher - Publishes messages to topics
  * 
  * Utility class to simplify publishing messages through MQTT broker.
+ * QoS 1 and 2 publishes are tracked until acknowledged by the broker;
+ * publish() blocks while the in-flight window is full and resends
+ * packets that stay unacknowledged longer than the retransmit timeout.
+ * The constructor connects to the broker (CONNECT / CONNACK), blocking
+ * until the CONNACK or the connect timeout, and every packet is sent with
+ * its MQTT wire size.
+ * Must be constructed by the actor that uses it.
  */
 class MQTTPublisher {
 private:
+    // Outstanding QoS 1/2 publish
+    struct InFlight {
+        std::shared_ptr<MQTTMessage> msg;
+        bool released;      // QoS 2: PUBREC received, PUBREL sent
+        double first_sent;
+        double sent_at;
+    };
+    
     std::string broker_name;
     std::string publisher_id;
     simgrid::s4u::Mailbox* broker_mbox;
+    simgrid::s4u::Mailbox* ack_mbox;
+    
+    MQTTQoSConfig qos_config;
+    std::map<int, InFlight> inflight;
+    int next_packet_id;
+    MQTTPublisherStats stats;
+    MQTTKeepAlive keepalive;
+    double connect_timeout;
+    
+    MQTTCodec codec;
+    size_t compress_min_size;
     
 public:
     /**
      * @brief Construct MQTT Publisher
      * @param broker Broker name to connect to
      * @param publisher_id Unique identifier for this publisher
+     * @param connect_timeout Maximum time to wait for the CONNACK (-1 for infinite)
+     * @throws std::runtime_error If the broker does not answer in time
      */
     MQTTPublisher(const std::string& broker = "mqtt_broker",
-                  const std::string& pub_id = "");
+                  const std::string& pub_id = "",
+                  double connect_timeout = 30.0);
     
     /**
      * @brief Publish a message to a topic
@@ -34,23 +84,94 @@ public:
      * @param payload Message content
      * @param size Message size in bytes
      * @param qos Quality of Service (0=at most once, 1=at least once, 2=exactly once)
+     * @param retain Broker keeps the message for future subscribers
+     *               (an empty retained message clears the topic)
      */
     void publish(const std::string& topic,
                  const std::string& payload,
                  size_t size,
-                 int qos = 0);
+                 int qos = 0,
+                 bool retain = false);
     
     /**
      * @brief Publish with automatic size calculation
      */
     void publish(const std::string& topic,
                  const std::string& payload,
-                 int qos = 0);
+                 int qos = 0,
+                 bool retain = false);
+    
+    /**
+     * @brief Publish several messages in a single transfer
+     * 
+     * The broker unpacks the batch and routes every message on its own;
+     * QoS 1/2 messages are acknowledged individually. Messages keep the
+     * timestamp they were created with.
+     * @param messages Messages to send (e.g. built with make_message())
+     */
+    void publish_batch(const std::vector<std::shared_ptr<MQTTMessage>>& messages);
+    
+    /**
+     * @brief Build a message stamped with this publisher's ID and the current time
+     */
+    std::shared_ptr<MQTTMessage> make_message(const std::string& topic,
+                                              const std::string& payload,
+                                              size_t size,
+                                              int qos = 0) const;
+    
+    /**
+     * @brief Wait until every QoS 1/2 publish has been acknowledged
+     * @param timeout Maximum time to wait (-1 for infinite)
+     * @return True if nothing is left in flight
+     */
+    bool wait_for_acks(double timeout = -1);
+    
+    /**
+     * @brief Set in-flight window and retransmit timeout for QoS 1/2
+     */
+    void set_qos_config(const MQTTQoSConfig& config) { qos_config = config; }
+    
+    /**
+     * @brief Send PINGREQ after @p interval seconds without traffic (0 = off)
+     */
+    void set_keepalive(double interval) { keepalive.start(publisher_id, broker_mbox, interval); }
+    
+    /**
+     * @brief Compress payloads with @p profile before sending
+     * 
+     * Compression runs on the publisher host (compress_cost flops per
+     * payload byte) and shrinks the message to compressed_size();
+     * subscribers pay the decompression cost when receiving.
+     * @param min_size Payloads smaller than this are sent uncompressed
+     */
+    void set_compression(const MQTTCodec& profile, size_t min_size = 0) {
+        codec = profile;
+        compress_min_size = min_size;
+    }
+    
+    /**
+     * @brief Number of QoS 1/2 publishes awaiting acknowledgement
+     */
+    size_t get_inflight_count() const { return inflight.size(); }
+    
+    /**
+     * @brief Get QoS statistics
+     */
+    const MQTTPublisherStats& get_stats() const { return stats; }
     
     /**
      * @brief Get publisher ID
      */
     const std::string& get_id() const { return publisher_id; }
+    
+private:
+    void connect();
+    void send(const std::shared_ptr<MQTTMessage>& msg, int packet_id, bool dup);
+    void send_control(MQTTControlMessage* msg);
+    void handle_ack(const MQTTControlMessage& ack);
+    bool process_acks(double timeout);
+    void retransmit_expired();
+    double next_retransmit_deadline() const;
 };
 
 } // namespace mqtt
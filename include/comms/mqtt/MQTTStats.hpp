@@ -0,0 +1,146 @@
+#ifndef ENIGMA_MQTT_STATS_HPP
+#define ENIGMA_MQTT_STATS_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+#include <cstdint>
+
+namespace enigma {
+namespace mqtt {
+
+/**
+ * @brief Log-bucketed latency histogram
+ *
+ * Buckets grow geometrically from MIN_VALUE (BUCKETS_PER_DECADE per factor
+ * of 10), so percentiles keep a bounded relative error (about 12%) from
+ * microseconds to hours at a fixed memory cost. Values below MIN_VALUE
+ * fall into the first bucket, values beyond the last decade into the last.
+ */
+class MQTTLatencyHistogram {
+public:
+    static constexpr double MIN_VALUE = 1e-6;
+    static constexpr int BUCKETS_PER_DECADE = 20;
+    static constexpr int DECADES = 10;
+    
+    MQTTLatencyHistogram();
+    
+    /**
+     * @brief Record one latency sample (seconds)
+     */
+    void record(double value);
+    
+    /**
+     * @brief Add all samples of another histogram
+     */
+    void merge(const MQTTLatencyHistogram& other);
+    
+    uint64_t count() const { return total; }
+    double min() const { return total > 0 ? min_value : 0.0; }
+    double max() const { return total > 0 ? max_value : 0.0; }
+    double mean() const { return total > 0 ? sum / total : 0.0; }
+    
+    /**
+     * @brief Approximate percentile
+     * @param p Percentile in [0, 100]
+     * @return Upper bound of the bucket holding the percentile, clamped to
+     *         the observed min/max (0 if empty)
+     */
+    double percentile(double p) const;
+    
+private:
+    std::vector<uint64_t> buckets;
+    uint64_t total;
+    double sum;
+    double min_value;
+    double max_value;
+    
+    static double bucket_upper_bound(size_t index);
+};
+
+/**
+ * @brief Statistics collection / export options
+ */
+struct MQTTStatsConfig {
+    std::string export_prefix;  // Write <prefix>_*.csv and <prefix>.json at shutdown ("" = off)
+    double sample_interval;     // Min. time between queue depth samples (0 = every event)
+    
+    MQTTStatsConfig()
+        : export_prefix(""),
+          sample_interval(1.0) {}
+};
+
+/**
+ * @brief Per-topic traffic statistics
+ */
+struct MQTTTopicStats {
+    int messages = 0;          // Messages published on the topic
+    size_t bytes = 0;
+    int deliveries = 0;        // Copies delivered to subscribers
+    double first_publish = 0;
+    double last_publish = 0;
+    MQTTLatencyHistogram latency;  // Publish -> delivery
+};
+
+/**
+ * @brief Broker queue depth at one point in time
+ */
+struct MQTTDepthSample {
+    double time;
+    size_t total_depth;     // Messages queued towards all subscribers
+    size_t max_depth;       // Deepest single subscriber queue
+    size_t inflight;        // Unacknowledged QoS 1/2 deliveries
+    size_t stored_bytes;    // Retained + offline session messages
+};
+
+/**
+ * @brief End-to-end statistics of one broker
+ *
+ * Latency is measured from MQTTMessage::timestamp (set when the publisher
+ * created the message) to the end of the transfer to the subscriber, so it
+ * includes publisher-side batching, bridging and broker queueing.
+ */
+class MQTTBrokerStats {
+public:
+    explicit MQTTBrokerStats(double start_time = 0.0);
+    
+    void record_publish(const std::string& topic, size_t size, double now);
+    void record_delivery(const std::string& subscriber, const std::string& topic,
+                         double latency);
+    void record_depth(const MQTTDepthSample& sample);
+    
+    const MQTTLatencyHistogram& get_latency() const { return latency; }
+    const std::map<std::string, MQTTTopicStats>& get_topics() const { return topics; }
+    const std::map<std::string, MQTTLatencyHistogram>& get_subscribers() const {
+        return subscribers;
+    }
+    const std::vector<MQTTDepthSample>& get_depth_samples() const { return depth_samples; }
+    
+    /**
+     * @brief Log latency percentiles and per-topic rates
+     */
+    void print(double now) const;
+    
+    /**
+     * @brief Write <prefix>_latency.csv, <prefix>_topics.csv and
+     *        <prefix>_queue_depth.csv
+     */
+    void export_csv(const std::string& prefix, double now) const;
+    
+    /**
+     * @brief Write all statistics to a single JSON file
+     */
+    void export_json(const std::string& filename, double now) const;
+    
+private:
+    double start_time;
+    MQTTLatencyHistogram latency;
+    std::map<std::string, MQTTTopicStats> topics;
+    std::map<std::string, MQTTLatencyHistogram> subscribers;
+    std::vector<MQTTDepthSample> depth_samples;
+};
+
+} // namespace mqtt
+} // namespace enigma
+
+#endif // ENIGMA_MQTT_STATS_HPP
@@ -2,10 +2,12 @@
 #define ENIGMA_MQTT_SUBSCRIBER_HPP
 
 #include "MQTTBroker.hpp"
+#include "MQTTKeepAlive.hpp"
+#include "MQTTDispatcher.hpp"
 #include <simgrid/s4u.hpp>
 #include <string>
 #include <vector>
-#include <functional>
+#include <set>
 
 namespace enigma {
 namespace mqtt {
@@ -14,6 +16,17 @@ namespace mqtt {
  * @brief MQTT Subscriber - Subscribes to topics and receives messages
  * 
  * Utility class to simplify subscribing to topics and receiving messages.
+ * QoS 1/2 deliveries are acknowledged to the broker inside receive(), and
+ * retransmitted QoS 2 deliveries are dropped before reaching the caller.
+ * QoS 2 releases (PUBREL) are answered whenever the subscriber waits in
+ * receive(), so the broker's in-flight window drains during long waits.
+ * Compressed payloads are decompressed on this host before being returned.
+ * The constructor connects to the broker (CONNECT / CONNACK), blocking
+ * until the CONNACK or the connect timeout.
+ * With a persistent session (clean_start = false) the broker keeps the
+ * subscriptions across disconnect() / reconnect() and queues messages
+ * published meanwhile, which are delivered in a burst after reconnecting.
+ * Must be constructed by the actor that uses it.
  */
 class MQTTSubscriber {
 private:
@@ -21,22 +34,57 @@ private:
     std::string subscriber_id;
     simgrid::s4u::Mailbox* broker_mbox;
     simgrid::s4u::Mailbox* my_mbox;
+    simgrid::s4u::Mailbox* ctrl_mbox;
     std::vector<std::string> subscribed_topics;
     
+    // QoS 2 packet ids received but not yet released by the broker
+    std::set<int> qos2_received;
+    int duplicates_dropped;
+    
+    // on_message() handlers and decompression
+    MQTTDispatcher dispatcher;
+    
+    MQTTKeepAlive keepalive;
+    double keepalive_interval;
+    
+    bool clean_start;
+    bool connected;
+    bool session_present;
+    double connect_timeout;
+    
+    // Receives left pending between calls; the broker's releases are
+    // answered while a delivery is awaited
+    simgrid::s4u::CommPtr delivery_comm;
+    MQTTDelivery* delivery_payload;
+    simgrid::s4u::CommPtr control_comm;
+    MQTTControlMessage* control_payload;
+    
 public:
     /**
      * @brief Construct MQTT Subscriber
      * @param broker Broker name to connect to
      * @param subscriber_id Unique identifier for this subscriber
+     * @param clean_start False to keep a persistent session on the broker
+     * @param connect_timeout Maximum time to wait for the CONNACK (-1 for infinite)
+     * @throws std::runtime_error If the broker does not answer in time
      */
     MQTTSubscriber(const std::string& broker = "mqtt_broker",
-                   const std::string& sub_id = "");
+                   const std::string& sub_id = "",
+                   bool clean_start = true,
+                   double connect_timeout = 30.0);
+    
+    ~MQTTSubscriber();
+    
+    // Pending receives write into this object
+    MQTTSubscriber(const MQTTSubscriber&) = delete;
+    MQTTSubscriber& operator=(const MQTTSubscriber&) = delete;
     
     /**
      * @brief Subscribe to a topic
      * @param topic Topic pattern (e.g., "sensors/temperature", "edge/#")
+     * @param qos Maximum QoS the broker may use for deliveries
      */
-    void subscribe(const std::string& topic);
+    void subscribe(const std::string& topic, int qos = 0);
     
     /**
      * @brief Unsubscribe from a topic
@@ -51,9 +99,75 @@ public:
      */
     std::shared_ptr<MQTTMessage> receive(double timeout = -1);
     
+    /**
+     * @brief Receive all messages that are ready, in one wakeup
+     * 
+     * Blocks for the first message like receive(), then drains up to
+     * @p max_n - 1 further messages already waiting without blocking again.
+     * @param max_n Maximum number of messages to return
+     * @param timeout Maximum time to wait for the first message (-1 for infinite)
+     * @return Received messages (empty on timeout)
+     */
+    std::vector<std::shared_ptr<MQTTMessage>> receive_batch(size_t max_n,
+                                                            double timeout = -1);
+    
+    /**
+     * @brief Register a handler for messages matching a topic filter
+     * @param topic_filter Filter (wildcards allowed); every matching handler is called
+     * @param handler Callback run by run() for each matching message
+     */
+    void on_message(const std::string& topic_filter, MQTTMessageHandler handler);
+    
+    /**
+     * @brief Dispatch loop: receive message batches and call the handlers
+     * 
+     * Returns when stop() is called from a handler, when no message arrives
+     * within @p idle_timeout, or once @p max_messages have been dispatched.
+     * @param idle_timeout Stop after this long without messages (-1 for infinite)
+     * @param max_messages Stop after this many messages (0 for unlimited)
+     * @return Number of messages dispatched
+     */
+    size_t run(double idle_timeout = -1, size_t max_messages = 0);
+    
+    /**
+     * @brief Make run() return after the current batch
+     */
+    void stop() { dispatcher.stop(); }
+    
+    /**
+     * @brief Send PINGREQ after @p interval seconds without traffic (0 = off)
+     */
+    void set_keepalive(double interval);
+    
+    /**
+     * @brief Leave the broker (DISCONNECT)
+     * 
+     * A clean session loses its subscriptions; a persistent session keeps
+     * them and the broker stores messages until reconnect().
+     */
+    void disconnect();
+    
+    /**
+     * @brief Connect again after disconnect()
+     * @return True if the broker resumed the persistent session
+     * @throws std::runtime_error If the broker does not answer within the
+     *         connect timeout (the subscriber stays disconnected)
+     */
+    bool reconnect();
+    
+    /**
+     * @brief Whether the subscriber is connected to the broker
+     */
+    bool is_connected() const { return connected; }
+    
+    /**
+     * @brief Whether the last CONNACK reported a resumed session
+     */
+    bool is_session_present() const { return session_present; }
+    
     /**
      * @brief Check if messages are available
-     * @return True if messages are ready
+     * @return True if messages are waiting to be received
      */
     bool has_messages() const;
     
@@ -71,6 +185,33 @@ public:
      * @brief Get list of subscribed topics
      */
     const std::vector<std::string>& get_topics() const { return subscribed_topics; }
+    
+    /**
+     * @brief Number of retransmitted QoS 2 deliveries suppressed
+     */
+    int get_duplicates_dropped() const { return duplicates_dropped; }
+    
+    /**
+     * @brief Number of compressed messages received
+     */
+    int get_messages_decompressed() const { return dispatcher.get_messages_decompressed(); }
+    
+    /**
+     * @brief Time spent decompressing payloads (s)
+     */
+    double get_decompression_time() const { return dispatcher.get_decompression_time(); }
+    
+private:
+    void connect();
+    bool acknowledge(const MQTTDelivery& delivery);
+    MQTTDelivery* wait_delivery(double deadline);
+    MQTTDelivery* poll_delivery();
+    MQTTControlMessage* wait_control(double deadline);
+    simgrid::s4u::CommPtr post_control();
+    simgrid::s4u::ActivityPtr wait_any(simgrid::s4u::ActivitySet& pending, double deadline);
+    void process_control();
+    void handle_control(MQTTControlMessage* ctrl_msg);
+    void send_to_broker(MQTTControlMessage* msg);
 };
 
 } // namespace mqtt
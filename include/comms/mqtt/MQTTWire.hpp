@@ -0,0 +1,108 @@
+#ifndef ENIGMA_MQTT_WIRE_HPP
+#define ENIGMA_MQTT_WIRE_HPP
+
+#include <cstddef>
+
+namespace enigma {
+namespace mqtt {
+
+/**
+ * @brief MQTT 5 packet sizes on the wire (bytes)
+ *
+ * Every packet is a fixed header (1 byte packet type and flags, then the
+ * "remaining length" as a 1-4 byte variable length integer) followed by
+ * the variable header and the payload. Property blocks are modelled by
+ * their length; an empty block still costs its 1 byte length field.
+ */
+struct MQTTWire {
+    /**
+     * @brief Size of a variable byte integer (7 bits per byte)
+     */
+    static size_t varint_size(size_t value) {
+        if (value < 128) return 1;
+        if (value < 16384) return 2;
+        if (value < 2097152) return 3;
+        return 4;
+    }
+    
+    /**
+     * @brief Fixed header + remaining bytes
+     */
+    static size_t packet(size_t remaining) {
+        return 1 + varint_size(remaining) + remaining;
+    }
+    
+    /**
+     * @brief UTF-8 string field (2 byte length prefix)
+     */
+    static size_t string_field(size_t length) {
+        return 2 + length;
+    }
+    
+    /**
+     * @brief Property block: length + properties
+     */
+    static size_t properties(size_t length = 0) {
+        return varint_size(length) + length;
+    }
+    
+    /**
+     * @brief PUBLISH: topic, packet id (QoS > 0 only), properties, payload
+     */
+    static size_t publish(size_t topic_length, size_t payload, bool has_packet_id,
+                          size_t property_bytes = 0) {
+        return packet(string_field(topic_length) + (has_packet_id ? 2 : 0) +
+                      properties(property_bytes) + payload);
+    }
+    
+    /**
+     * @brief PUBACK / PUBREC / PUBREL / PUBCOMP with success reason code
+     *
+     * MQTT 5 omits the reason code and properties when the reason is
+     * "success", leaving just the packet id.
+     */
+    static size_t ack() {
+        return packet(2);
+    }
+    
+    /**
+     * @brief SUBSCRIBE with a single topic filter and its options byte
+     */
+    static size_t subscribe(size_t filter_length) {
+        return packet(2 + properties() + string_field(filter_length) + 1);
+    }
+    
+    /**
+     * @brief UNSUBSCRIBE with a single topic filter
+     */
+    static size_t unsubscribe(size_t filter_length) {
+        return packet(2 + properties() + string_field(filter_length));
+    }
+    
+    /**
+     * @brief CONNECT: protocol name and level, flags, keepalive, client id
+     */
+    static size_t connect(size_t client_id_length) {
+        const size_t variable_header = string_field(4) + 1 + 1 + 2;  // "MQTT", 5, flags, keepalive
+        return packet(variable_header + properties() + string_field(client_id_length));
+    }
+    
+    /**
+     * @brief CONNACK: acknowledge flags, reason code, properties
+     */
+    static size_t connack() {
+        return packet(1 + 1 + properties());
+    }
+    
+    /**
+     * @brief PINGREQ / PINGRESP / DISCONNECT (no variable header)
+     */
+    static size_t empty() {
+        return packet(0);
+    }
+};
+
+} // namespace mqtt
+} // namespace enigma
+
+#endif // ENIGMA_MQTT_WIRE_HPP
@@ -0,0 +1,21 @@
+#ifndef ENIGMA_P2P_HPP
+#define ENIGMA_P2P_HPP
+
+/**
+ * @file P2P.hpp
+ * @brief Convenience header for brokerless publish/subscribe
+ *
+ * Include this file to access all P2P components:
+ * - P2PDomain: Discovery of publishers and subscriptions
+ * - P2PPublisher: Publish messages directly to matching subscribers
+ * - P2PSubscriber: Subscribe and receive messages
+ *
+ * Messages are mqtt::MQTTMessage, so handlers and statistics written for
+ * MQTT work unchanged on the P2P transport.
+ */
+
+#include "comms/p2p/P2PDomain.hpp"
+#include "comms/p2p/P2PPublisher.hpp"
+#include "comms/p2p/P2PSubscriber.hpp"
+
+#endif // ENIGMA_P2P_HPP
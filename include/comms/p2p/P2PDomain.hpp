@@ -0,0 +1,109 @@
+#ifndef ENIGMA_P2P_DOMAIN_HPP
+#define ENIGMA_P2P_DOMAIN_HPP
+
+#include "comms/mqtt/MQTTBroker.hpp"
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <memory>
+
+namespace enigma {
+namespace p2p {
+
+using mqtt::MQTTMessage;
+
+/**
+ * @brief A message as sent directly from a publisher to one subscriber
+ */
+struct P2PSample {
+    std::shared_ptr<MQTTMessage> message;
+    
+    explicit P2PSample(std::shared_ptr<MQTTMessage> m) : message(std::move(m)) {}
+};
+
+/**
+ * @brief Endpoint discovery announcement sent by a subscriber to publishers
+ */
+struct P2PAnnouncement {
+    enum class Type {
+        SUBSCRIBE,
+        UNSUBSCRIBE
+    };
+    
+    Type type;
+    std::string subscriber;
+    std::string filter;
+    
+    P2PAnnouncement(Type t, const std::string& sub, const std::string& f)
+        : type(t), subscriber(sub), filter(f) {}
+};
+
+/**
+ * @brief Packet sizes on the wire (bytes), modelled after DDS/RTPS
+ *
+ * Samples carry no topic name (the writer is identified by its GUID), only
+ * the RTPS header, a timestamp and the DATA submessage header.
+ */
+struct P2PWire {
+    static constexpr size_t DATA_HEADER = 20 + 12 + 24;  // RTPS + INFO_TS + DATA
+    static constexpr size_t ANNOUNCEMENT = 256;          // Endpoint data without the filter
+    
+    static size_t sample(const MQTTMessage& msg) {
+        return DATA_HEADER + msg.properties + msg.size;
+    }
+    
+    static size_t announcement(size_t filter_length) {
+        return ANNOUNCEMENT + filter_length;
+    }
+};
+
+/**
+ * @brief Participants and subscriptions of a discovery domain
+ *
+ * Stands in for the participant discovery of DDS: it tells a new publisher
+ * which subscriptions already exist and a new subscription which
+ * publishers to announce itself to. Subscription changes reach running
+ * publishers through announcements sent over the network, so they take
+ * effect after the announcement transfer time.
+ */
+class P2PDomain {
+public:
+    struct Subscription {
+        std::string subscriber;
+        std::string filter;
+    };
+    
+    static void add_publisher(const std::string& domain, const std::string& publisher);
+    static void remove_publisher(const std::string& domain, const std::string& publisher);
+    static std::vector<std::string> get_publishers(const std::string& domain);
+    
+    static void add_subscription(const std::string& domain, const Subscription& sub);
+    static void remove_subscription(const std::string& domain, const Subscription& sub);
+    static std::vector<Subscription> get_subscriptions(const std::string& domain);
+    
+    /**
+     * @brief Mailbox a subscriber receives samples on
+     */
+    static std::string get_data_mailbox(const std::string& domain,
+                                        const std::string& subscriber);
+    
+    /**
+     * @brief Mailbox a publisher receives announcements on
+     */
+    static std::string get_discovery_mailbox(const std::string& domain,
+                                             const std::string& publisher);
+    
+private:
+    struct Registry {
+        std::set<std::string> publishers;
+        std::vector<Subscription> subscriptions;
+    };
+    
+    static Registry& registry(const std::string& domain);
+};
+
+} // namespace p2p
+} // namespace enigma
+
+#endif // ENIGMA_P2P_DOMAIN_HPP
@@ -0,0 +1,138 @@
+#ifndef ENIGMA_P2P_PUBLISHER_HPP
+#define ENIGMA_P2P_PUBLISHER_HPP
+
+#include "P2PDomain.hpp"
+#include "comms/mqtt/MQTTCompression.hpp"
+#include <simgrid/s4u.hpp>
+#include <string>
+#include <vector>
+
+namespace enigma {
+namespace p2p {
+
+/**
+ * @brief Publisher-side traffic statistics
+ */
+struct P2PPublisherStats : mqtt::MQTTCompressionStats {
+    int messages_sent;          // publish() calls
+    int deliveries;             // Copies sent to subscribers
+    size_t bytes_sent;          // Sample bytes sent (all copies)
+    int announcements;          // Discovery announcements processed
+    int copies_cancelled;       // Reliable copies not taken before the send timeout
+    int subscribers_dropped;    // Subscribers forgotten after a send timeout
+    
+    P2PPublisherStats()
+        : messages_sent(0), deliveries(0), bytes_sent(0), announcements(0),
+          copies_cancelled(0), subscribers_dropped(0) {}
+};
+
+/**
+ * @brief Brokerless publisher - sends every message directly to the
+ *        mailboxes of the matching subscribers
+ *
+ * Same publishing API as mqtt::MQTTPublisher, but there is no broker hop:
+ * the publisher keeps the subscriptions it discovered and sends one copy per
+ * matching subscriber from its own host. With reliable delivery (default)
+ * publish() returns once every copy has been transferred, or after the
+ * send timeout: a subscriber that has not taken its copy by then is
+ * dropped until it announces its subscriptions again. Best effort sends
+ * the copies without waiting. QoS values are accepted for API
+ * compatibility and stored in the message.
+ * Must be constructed by the actor that uses it.
+ */
+class P2PPublisher {
+private:
+    std::string domain;
+    std::string publisher_id;
+    simgrid::s4u::Mailbox* discovery_mbox;
+    
+    // Reliable copy of a message on its way to one subscriber
+    struct Copy {
+        std::string subscriber;
+        P2PSample* sample;
+        simgrid::s4u::CommPtr comm;
+    };
+    
+    std::vector<P2PDomain::Subscription> matched;  // Discovered subscriptions
+    bool reliable;
+    double send_timeout;
+    P2PPublisherStats stats;
+    
+    mqtt::MQTTCodec codec;
+    size_t compress_min_size;
+    
+public:
+    /**
+     * @brief Construct P2P Publisher
+     * @param domain Discovery domain to join
+     * @param pub_id Unique identifier for this publisher
+     */
+    P2PPublisher(const std::string& domain = "default", const std::string& pub_id = "");
+    ~P2PPublisher();
+    
+    P2PPublisher(const P2PPublisher&) = delete;
+    P2PPublisher& operator=(const P2PPublisher&) = delete;
+    
+    /**
+     * @brief Publish a message to a topic
+     * @param topic Topic name (e.g., "sensors/temperature")
+     * @param payload Message content
+     * @param size Message size in bytes
+     * @param qos Stored in the message (delivery follows set_reliable())
+     */
+    void publish(const std::string& topic,
+                 const std::string& payload,
+                 size_t size,
+                 int qos = 0);
+    
+    /**
+     * @brief Publish with automatic size calculation
+     */
+    void publish(const std::string& topic,
+                 const std::string& payload,
+                 int qos = 0);
+    
+    /**
+     * @brief Wait for every copy to be transferred (true) or fire and forget
+     */
+    void set_reliable(bool value) { reliable = value; }
+    
+    /**
+     * @brief Maximum time a reliable publish waits for its copies (-1 for infinite)
+     */
+    void set_send_timeout(double timeout) { send_timeout = timeout; }
+    
+    /**
+     * @brief Compress payloads with @p profile before sending
+     * 
+     * Same model as mqtt::MQTTPublisher::set_compression(): the publisher
+     * pays the compression cost once per message, and every copy is sent
+     * at the compressed size.
+     * @param min_size Payloads smaller than this are sent uncompressed
+     */
+    void set_compression(const mqtt::MQTTCodec& profile, size_t min_size = 0) {
+        codec = profile;
+        compress_min_size = min_size;
+    }
+    
+    /**
+     * @brief Number of subscribers a message on @p topic would be sent to
+     */
+    size_t get_subscriber_count(const std::string& topic);
+    
+    const P2PPublisherStats& get_stats() const { return stats; }
+    
+    const std::string& get_id() const { return publisher_id; }
+    
+private:
+    void process_discovery();
+    std::vector<std::string> match(const std::string& topic) const;
+    bool is_matched(const std::string& subscriber) const;
+    int wait_copies(std::vector<Copy>& copies);
+    void drop(const std::string& subscriber);
+};
+
+} // namespace p2p
+} // namespace enigma
+
+#endif // ENIGMA_P2P_PUBLISHER_HPP
@@ -0,0 +1,131 @@
+#ifndef ENIGMA_P2P_SUBSCRIBER_HPP
+#define ENIGMA_P2P_SUBSCRIBER_HPP
+
+#include "P2PDomain.hpp"
+#include "comms/mqtt/MQTTDispatcher.hpp"
+#include <simgrid/s4u.hpp>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace enigma {
+namespace p2p {
+
+using mqtt::MQTTMessageHandler;
+
+/**
+ * @brief Brokerless subscriber - receives messages directly from publishers
+ *
+ * Same receiving API as mqtt::MQTTSubscriber. subscribe() registers the
+ * filter in the domain and announces it to every known publisher; each
+ * announcement costs one transfer per publisher, so subscribing is the
+ * expensive part of a broker-less deployment. Compressed payloads are
+ * decompressed on this host before being returned.
+ * Must be constructed by the actor that uses it.
+ */
+class P2PSubscriber {
+private:
+    std::string domain;
+    std::string subscriber_id;
+    simgrid::s4u::Mailbox* my_mbox;
+    std::vector<std::string> subscribed_topics;
+    int announcements_sent;
+    
+    // on_message() handlers and decompression
+    mqtt::MQTTDispatcher dispatcher;
+    
+public:
+    /**
+     * @brief Construct P2P Subscriber
+     * @param domain Discovery domain to join
+     * @param sub_id Unique identifier for this subscriber
+     */
+    P2PSubscriber(const std::string& domain = "default", const std::string& sub_id = "");
+    ~P2PSubscriber();
+    
+    P2PSubscriber(const P2PSubscriber&) = delete;
+    P2PSubscriber& operator=(const P2PSubscriber&) = delete;
+    
+    /**
+     * @brief Subscribe to a topic
+     * @param topic Topic pattern (wildcards allowed)
+     * @param qos Accepted for API compatibility
+     */
+    void subscribe(const std::string& topic, int qos = 0);
+    
+    /**
+     * @brief Unsubscribe from a topic
+     */
+    void unsubscribe(const std::string& topic);
+    
+    /**
+     * @brief Receive next message (blocking)
+     * @param timeout Maximum time to wait (-1 for infinite)
+     * @return Received message or nullptr if timeout
+     */
+    std::shared_ptr<MQTTMessage> receive(double timeout = -1);
+    
+    /**
+     * @brief Receive all messages that are ready, in one wakeup
+     * @param max_n Maximum number of messages to return
+     * @param timeout Maximum time to wait for the first message (-1 for infinite)
+     * @return Received messages (empty on timeout)
+     */
+    std::vector<std::shared_ptr<MQTTMessage>> receive_batch(size_t max_n,
+                                                            double timeout = -1);
+    
+    /**
+     * @brief Register a handler for messages matching a topic filter
+     * @param topic_filter Filter (wildcards allowed); every matching handler is called
+     * @param handler Callback run by run() for each matching message
+     */
+    void on_message(const std::string& topic_filter, MQTTMessageHandler handler);
+    
+    /**
+     * @brief Dispatch loop: receive message batches and call the handlers
+     * 
+     * Returns when stop() is called from a handler, when no message arrives
+     * within @p idle_timeout, or once @p max_messages have been dispatched.
+     * @param idle_timeout Stop after this long without messages (-1 for infinite)
+     * @param max_messages Stop after this many messages (0 for unlimited)
+     * @return Number of messages dispatched
+     */
+    size_t run(double idle_timeout = -1, size_t max_messages = 0);
+    
+    /**
+     * @brief Make run() return after the current batch
+     */
+    void stop() { dispatcher.stop(); }
+    
+    /**
+     * @brief Check if messages are available
+     */
+    bool has_messages() const;
+    
+    const std::string& get_id() const { return subscriber_id; }
+    
+    const std::vector<std::string>& get_topics() const { return subscribed_topics; }
+    
+    /**
+     * @brief Discovery announcements sent to publishers
+     */
+    int get_announcements_sent() const { return announcements_sent; }
+    
+    /**
+     * @brief Number of compressed messages received
+     */
+    int get_messages_decompressed() const { return dispatcher.get_messages_decompressed(); }
+    
+    /**
+     * @brief Time spent decompressing payloads (s)
+     */
+    double get_decompression_time() const { return dispatcher.get_decompression_time(); }
+    
+private:
+    void announce(P2PAnnouncement::Type type, const std::string& topic);
+};
+
+} // namespace p2p
+} // namespace enigma
+
+#endif // ENIGMA_P2P_SUBSCRIBER_HPP
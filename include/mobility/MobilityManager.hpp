@@ -15,6 +15,10 @@
  *   </zone>
  * @endcode
  * The directory is relative to the working directory when the simulator runs.
+ * The value may also name a single file: a trace pack written by
+ * ``trace_convert`` (see TracePack.hpp), which is memory-mapped instead of
+ * parsed, or a long-format CSV holding all devices with a device column
+ * (see MobilityTrace::load_long_csv()).
  *
  * ## 2. Create the manager after loading the platform
  * @code
@@ -31,6 +35,18 @@
  *   if (pos) XBT_INFO("lat=%.6f lon=%.6f", pos->latitude, pos->longitude);
  * @endcode
  *
+ * In hot loops, resolve the device once and query by handle:
+ * @code
+ *   DeviceHandle h = mob.handle_of(simgrid::s4u::this_actor::get_host());
+ *   auto view = mob.view_at(h, simgrid::s4u::Engine::get_clock());
+ * @endcode
+ *
+ * ## 3b. Query many devices at once
+ * @code
+ *   std::vector<PositionView> out(mob.trace_count());
+ *   mob.positions_at(mob.handles().data(), out.size(), t, out.data());
+ * @endcode
+ *
  * ## 4. Optionally: launch the periodic snapshot actor
  * @code
  *   mob.start_periodic_actor(*e, 1.0);  // snapshot every 1 sim-second
@@ -45,17 +61,42 @@
 
 #include "MobilityPosition.hpp"
 #include "MobilityTrace.hpp"
+#include "TraceStream.hpp"
 
 #include <simgrid/s4u.hpp>
 
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace enigma::mobility {
 
+/// Dense index of a loaded device (0 .. trace_count()-1, in name order).
+using DeviceHandle = std::uint32_t;
+
+/// Returned by MobilityManager::handle_of() for devices without a trace.
+constexpr DeviceHandle NO_DEVICE = static_cast<DeviceHandle>(-1);
+
+/// Options controlling how MobilityManager loads traces.
+struct MobilityOptions {
+    /// Threads parsing trace files concurrently (0 = hardware concurrency).
+    unsigned load_workers = 0;
+
+    /// Rows kept per trace (default: all); see TraceWindow.
+    TraceWindow window;
+
+    /// > 0: streaming mode.  Per-device CSV traces are paged in chunks of
+    /// this many trace seconds as simulated time advances (see TraceStream;
+    /// rows must be in time order).  Packs and long-format CSVs are always
+    /// loaded whole (within the window).
+    double stream_chunk = 0.0;
+};
+
 /// A recorded snapshot: device name + interpolated position.
 struct Snapshot {
     std::string    device_name;
@@ -68,23 +109,33 @@ public:
      * @brief Construct, auto-detecting the coords directory.
      *
      * Reads the `mobility_dir` property from the first zone of @p engine's
-     * platform that exposes it.  Loads all *.csv files found there.
+     * platform that exposes it.  Loads all *.csv files found there, or the
+     * traces of the pack / long-format CSV it names.
      * If the property is absent, no traces are loaded (the manager is a no-op).
      */
-    explicit MobilityManager(simgrid::s4u::Engine& engine);
+    explicit MobilityManager(simgrid::s4u::Engine& engine,
+                             const MobilityOptions& options = {});
 
     /**
      * @brief Construct with an explicit directory path.
-     * Loads all *.csv files inside @p coords_dir.
+     * Loads all *.csv files inside @p coords_dir, or the traces of the pack
+     * / long-format CSV @p coords_dir names.
      */
-    MobilityManager(simgrid::s4u::Engine& engine, const std::string& coords_dir);
+    MobilityManager(simgrid::s4u::Engine& engine, const std::string& coords_dir,
+                    const MobilityOptions& options = {});
 
     // ------------------------------------------------------------------ //
     // Query
     // ------------------------------------------------------------------ //
 
     /// Number of device traces loaded.
-    std::size_t trace_count() const noexcept { return traces_.size(); }
+    std::size_t trace_count() const noexcept { return devices_.size(); }
+
+    /// Handles of all loaded devices, in name order.
+    const std::vector<DeviceHandle>& handles() const noexcept { return handles_; }
+
+    /// Name of the device behind handle @p h.
+    const std::string& device_name(DeviceHandle h) const { return devices_.at(h).name; }
 
     /// True if a trace is available for @p device_name.
     bool has_trace(const std::string& device_name) const noexcept;
@@ -92,17 +143,80 @@ public:
     /**
      * @brief Interpolated position for @p device_name at @p sim_t.
      * Returns std::nullopt if no trace is loaded for that device.
+     *
+     * Resumes from the device's cursor (see TraceCursor), so queries that
+     * follow simulated time cost O(1) amortized.  Cursors are shared by all
+     * callers of a device; actors run one at a time, so this needs no lock.
      */
     std::optional<MobilityPosition> position_at(const std::string& device_name,
                                                   double sim_t) const noexcept;
 
+    /// As position_at(), with a cursor owned by the caller (e.g. an actor
+    /// replaying a device's past while others follow the clock).
+    std::optional<MobilityPosition> position_at(const std::string& device_name,
+                                                  double sim_t,
+                                                  TraceCursor& cursor) const noexcept;
+
+    /**
+     * @brief Allocation-free position query (see MobilityTrace::view_at).
+     *
+     * @p extra_out, if given, receives the extra columns in the layout of
+     * trace(device_name)->extra_names().  Uses the device's cursor.
+     */
+    std::optional<PositionView> view_at(const std::string& device_name, double sim_t,
+                                        double* extra_out = nullptr) const noexcept;
+
+    /// Trace of @p device_name, or nullptr if none is loaded.  In streaming
+    /// mode, the resident chunk.
+    const MobilityTrace* trace(const std::string& device_name) const noexcept;
+
+    // ------------------------------------------------------------------ //
+    // Query by handle (no string lookup)
+    // ------------------------------------------------------------------ //
+
+    /// Handle of @p device_name, or NO_DEVICE.
+    DeviceHandle handle_of(const std::string& device_name) const noexcept;
+
+    /// Handle of the trace named after @p host, or NO_DEVICE.  Uses a table
+    /// built from the engine's hosts at construction.
+    DeviceHandle handle_of(const simgrid::s4u::Host* host) const noexcept;
+
+    /// True if @p h refers to a loaded trace.
+    bool has_trace(DeviceHandle h) const noexcept { return h < devices_.size(); }
+
+    /// position_at() by handle; std::nullopt for an invalid handle.
+    std::optional<MobilityPosition> position_at(DeviceHandle h, double sim_t) const noexcept;
+
+    /// view_at() by handle; std::nullopt for an invalid handle.
+    std::optional<PositionView> view_at(DeviceHandle h, double sim_t,
+                                        double* extra_out = nullptr) const noexcept;
+
+    /// Trace behind @p h, or nullptr for an invalid handle (the resident
+    /// chunk in streaming mode).
+    const MobilityTrace* trace(DeviceHandle h) const noexcept {
+        return has_trace(h) ? &devices_[h].trace : nullptr;
+    }
+
+    /**
+     * @brief Coordinates of @p count devices at @p sim_t in one pass.
+     *
+     * @p out[i] receives the position of @p handles[i] (NaN coordinates for
+     * an unknown handle).  Devices are processed in blocks: segments are
+     * located per device (using its cursor) and the endpoints gathered into
+     * contiguous buffers, then the whole block is interpolated in one
+     * branch-free loop the compiler vectorises.
+     */
+    void positions_at(const DeviceHandle* handles, std::size_t count,
+                      double sim_t, PositionView* out) const noexcept;
+
     // ------------------------------------------------------------------ //
     // Snapshot recording
     // ------------------------------------------------------------------ //
 
     /**
      * @brief Record a snapshot of ALL devices at @p sim_t.
-     * Thread-safe; can be called from any actor.
+     * Uses positions_at(); extra columns are interpolated only for devices
+     * that have some.  Thread-safe; can be called from any actor.
      */
     void record_all(double sim_t);
 
@@ -112,8 +226,17 @@ public:
      */
     void record(const std::string& device_name, double sim_t);
 
-    /// All recorded snapshots (ordered by time of record() call).
-    const std::vector<Snapshot>& snapshots() const noexcept { return snapshots_; }
+    /// record() by handle.  Thread-safe.
+    void record(DeviceHandle h, double sim_t);
+
+    /// Number of recorded snapshots.
+    std::size_t snapshot_count() const noexcept { return snap_device_.size(); }
+
+    /**
+     * @brief All recorded snapshots (ordered by time of record() call).
+     * Snapshots are stored column-wise; this assembles a copy.
+     */
+    std::vector<Snapshot> snapshots() const;
 
     // ------------------------------------------------------------------ //
     // Periodic actor
@@ -145,18 +268,50 @@ public:
 
     /**
      * @brief Export full raw traces (not just snapshots) to JSON.
-     * Useful when no periodic actor was used.
+     * Useful when no periodic actor was used.  In streaming mode only the
+     * resident chunks are written.
      */
     void export_traces_json(const std::string& filename) const;
 
 private:
     void load_directory(const std::string& dir_path);
+    void load_pack(const std::string& pack_path);
+    void load_long_csv(const std::string& csv_path);
+    void add_devices(std::map<std::string, MobilityTrace>& traces,
+                     std::map<std::string, std::unique_ptr<TraceStream>> streams = {});
+    void build_host_table(simgrid::s4u::Engine& engine);
     std::string detect_mobility_dir(simgrid::s4u::Engine& engine) const;
 
-    std::map<std::string, MobilityTrace> traces_;  ///< keyed by device_name
-    std::vector<Snapshot>               snapshots_;
+    /// A loaded trace and the cursor of the manager's own queries.
+    struct Device {
+        std::string                  name;
+        mutable MobilityTrace        trace;   ///< resident chunk when streaming
+        mutable TraceCursor          cursor;
+        std::unique_ptr<TraceStream> stream;  ///< streaming mode only
+
+        /// Trace to query at @p sim_t (pages the next chunk in if streaming).
+        const MobilityTrace& at(double sim_t) const noexcept;
+    };
+
+    const Device* find(const std::string& device_name) const noexcept;
+    void append_extras(const Device& dev, double sim_t);
+    template <typename F> void for_each_snapshot(F&& f) const;
+
+    std::vector<Device>                 devices_;  ///< indexed by DeviceHandle
+    std::vector<DeviceHandle>           handles_;  ///< 0 .. devices_.size()-1
+
+    /// device_name -> handle
+    std::unordered_map<std::string, DeviceHandle>               index_;
+    /// host -> handle, for hosts that have a trace
+    std::unordered_map<const simgrid::s4u::Host*, DeviceHandle> hosts_;
+
+    // Recorded snapshots, one entry per row; extras in the device's column layout
+    std::vector<DeviceHandle>           snap_device_;
+    std::vector<PositionView>           snap_position_;
+    std::vector<double>                 snap_extra_;
     mutable std::mutex                  mutex_;
     std::string                         coords_dir_;
+    MobilityOptions                     options_;
 };
 
 } // namespace enigma::mobility
@@ -10,6 +10,9 @@
  * name – are stored in** ``extra`` as a ``std::map<std::string, double>``
  * and are serialised/interpolated automatically.  There is no assumed schema
  * beyond the three mandatory fields.
+ *
+ * ``PositionView`` is the allocation-free counterpart for hot paths that only
+ * need the coordinates.
  */
 
 #include <cmath>
@@ -21,6 +24,30 @@ namespace enigma::mobility {
 /// Earth radius in metres (WGS-84 mean)
 constexpr double EARTH_RADIUS_M = 6'371'000.0;
 
+/// Haversine distance between two WGS-84 coordinates in metres.
+inline double haversine_m(double lat1, double lon1, double lat2, double lon2) noexcept {
+    const double phi1 = lat1 * M_PI / 180.0;
+    const double phi2 = lat2 * M_PI / 180.0;
+    const double dphi = (lat2 - lat1) * M_PI / 180.0;
+    const double dlam = (lon2 - lon1) * M_PI / 180.0;
+    const double a = std::sin(dphi / 2) * std::sin(dphi / 2) +
+                     std::cos(phi1) * std::cos(phi2) *
+                     std::sin(dlam / 2) * std::sin(dlam / 2);
+    return EARTH_RADIUS_M * 2.0 * std::atan2(std::sqrt(a), std::sqrt(1.0 - a));
+}
+
+/// Coordinates only – trivially copyable, never allocates.
+struct PositionView {
+    double timestamp  = 0.0;   ///< Simulation or wall-clock time (s)
+    double latitude   = 0.0;   ///< Decimal degrees, WGS-84
+    double longitude  = 0.0;   ///< Decimal degrees, WGS-84
+
+    /// Haversine distance to *other* in metres.
+    double distance_to(const PositionView& other) const noexcept {
+        return haversine_m(latitude, longitude, other.latitude, other.longitude);
+    }
+};
+
 /// One position snapshot (one CSV row).
 struct MobilityPosition {
     double timestamp  = 0.0;   ///< Simulation or wall-clock time (s)
@@ -32,14 +59,7 @@ struct MobilityPosition {
 
     /// Haversine distance to *other* in metres.
     double distance_to(const MobilityPosition& other) const noexcept {
-        const double phi1 = latitude  * M_PI / 180.0;
-        const double phi2 = other.latitude  * M_PI / 180.0;
-        const double dphi = (other.latitude  - latitude)  * M_PI / 180.0;
-        const double dlam = (other.longitude - longitude) * M_PI / 180.0;
-        const double a = std::sin(dphi / 2) * std::sin(dphi / 2) +
-                         std::cos(phi1) * std::cos(phi2) *
-                         std::sin(dlam / 2) * std::sin(dlam / 2);
-        return EARTH_RADIUS_M * 2.0 * std::atan2(std::sqrt(a), std::sqrt(1.0 - a));
+        return haversine_m(latitude, longitude, other.latitude, other.longitude);
     }
 };
 
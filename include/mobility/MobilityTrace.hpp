@@ -8,10 +8,19 @@
  *
  * Only ``timestamp`` (aliases: time, t, ts),
  * ``latitude`` (alias: lat), and ``longitude`` (aliases: lon, lng)
- * are required.  All other columns are stored in
+ * are required.  All other columns are reported in
  * ``MobilityPosition::extra`` keyed by their lower-cased column name.
  * There is no assumed schema beyond the three mandatory fields.
  *
+ * Storage is columnar: timestamps, latitudes, longitudes and every numeric
+ * extra column are contiguous ``double`` arrays.  Rows without a numeric
+ * value for an extra column hold NaN there; columns with no numeric value at
+ * all (e.g. ``stop_name``) are dropped on load.
+ *
+ * The file is read into one buffer and parsed in place with
+ * ``std::from_chars``; rows whose timestamp, latitude or longitude is missing
+ * or not a number are skipped and counted (malformed_rows()).
+ *
  * The trace is sorted by timestamp on load; queries outside the range are
  * clamped to the first / last entry.
  *
@@ -24,34 +33,157 @@
  */
 
 #include "MobilityPosition.hpp"
+#include <cstdint>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace enigma::mobility {
 
+/**
+ * @brief Query position inside one trace, kept between position_at() calls.
+ *
+ * Simulated time only moves forward, so the next query usually falls in the
+ * same or the following segment: with a cursor it is found by stepping
+ * forward instead of a binary search.  Backward or long forward jumps fall
+ * back to the binary search.  A cursor is only a hint (any value gives the
+ * correct result); use one per caller and trace.
+ */
+struct TraceCursor {
+    std::size_t segment = 0;  ///< Index of the first waypoint of the last segment
+};
+
+/**
+ * @brief Time range of a trace to keep in memory.
+ *
+ * Rows in [t_begin - margin, t_end + margin] are kept, plus the nearest
+ * waypoint beyond each edge, so interpolation anywhere inside the range
+ * gives the same result as with the whole trace.  Queries outside the range
+ * are clamped to those edge waypoints.
+ */
+struct TraceWindow {
+    double t_begin = -std::numeric_limits<double>::infinity();
+    double t_end   =  std::numeric_limits<double>::infinity();
+    double margin  = 0.0;  ///< seconds added on both sides
+
+    double lo() const noexcept { return t_begin - margin; }
+    double hi() const noexcept { return t_end + margin; }
+};
+
+/**
+ * @brief Read-only view of one trace column (contiguous doubles).
+ *
+ * The values live in the trace (parsed from CSV) or in a memory-mapped
+ * trace pack (see TracePack); the view stays valid as long as the trace.
+ */
+class TraceColumn {
+public:
+    TraceColumn() = default;
+    TraceColumn(const double* data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    const double* data()  const noexcept { return data_; }
+    std::size_t   size()  const noexcept { return size_; }
+    bool          empty() const noexcept { return size_ == 0; }
+    const double* begin() const noexcept { return data_; }
+    const double* end()   const noexcept { return data_ + size_; }
+    double front() const noexcept { return data_[0]; }
+    double back()  const noexcept { return data_[size_ - 1]; }
+    double operator[](std::size_t i) const noexcept { return data_[i]; }
+
+private:
+    const double* data_ = nullptr;
+    std::size_t   size_ = 0;
+};
+
 class MobilityTrace {
 public:
-    /// Load trace from CSV file.  Throws std::runtime_error on I/O failure.
-    explicit MobilityTrace(const std::string& csv_path);
+    /// Load trace from CSV file, keeping the rows of @p window.
+    /// Throws std::runtime_error on I/O failure.
+    explicit MobilityTrace(const std::string& csv_path, const TraceWindow& window = {});
+
+    /**
+     * @brief Load every trace of a long-format CSV: one file, one row per
+     *        device and timestamp, with a device column.
+     *
+     * The file is streamed in one pass and its rows grouped by device, so
+     * memory holds the traces but never the whole file.  The device column
+     * is matched by alias (device, device_id, host, node, vehicle_id, id)
+     * and its values are used as device names verbatim.
+     *
+     * @param window      Rows to keep, per device.
+     * @param orphan_rows Optional output: skipped rows that belong to no
+     *                    trace (empty device, or a device without a single
+     *                    valid row).  Other skipped rows count in the
+     *                    malformed_rows() of their trace.
+     * @return Traces sorted by device name.
+     * Throws std::runtime_error on I/O failure or a missing column.
+     */
+    static std::vector<MobilityTrace> load_long_csv(const std::string& csv_path,
+                                                    const TraceWindow& window = {},
+                                                    std::size_t* orphan_rows = nullptr);
+
+    // Columns may point into the trace's own storage: move-only
+    MobilityTrace(MobilityTrace&&) noexcept = default;
+    MobilityTrace& operator=(MobilityTrace&&) noexcept = default;
+    MobilityTrace(const MobilityTrace&) = delete;
+    MobilityTrace& operator=(const MobilityTrace&) = delete;
 
     /// Device/host name (derived from filename stem).
     const std::string& device_name() const noexcept { return device_name_; }
 
-    /// Path to the source CSV file.
+    /// Path to the source file (CSV, or the trace pack it was mapped from).
     const std::string& csv_path() const noexcept { return csv_path_; }
 
     /// Number of waypoints loaded.
-    std::size_t size() const noexcept { return waypoints_.size(); }
+    std::size_t size() const noexcept { return timestamps_.size(); }
+
+    /// Data rows skipped on load because timestamp, latitude or longitude
+    /// was missing or not a number.
+    std::size_t malformed_rows() const noexcept { return malformed_rows_; }
 
     /// Earliest timestamp in the trace (seconds).
-    double t_min() const noexcept { return waypoints_.empty() ? 0.0 : waypoints_.front().timestamp; }
+    double t_min() const noexcept { return timestamps_.empty() ? 0.0 : timestamps_.front(); }
 
     /// Latest  timestamp in the trace (seconds).
-    double t_max() const noexcept { return waypoints_.empty() ? 0.0 : waypoints_.back().timestamp; }
+    double t_max() const noexcept { return timestamps_.empty() ? 0.0 : timestamps_.back(); }
 
-    /// All raw waypoints (sorted by timestamp).
-    const std::vector<MobilityPosition>& waypoints() const noexcept { return waypoints_; }
+    // ------------------------------------------------------------------ //
+    // Columns
+    // ------------------------------------------------------------------ //
+
+    /// Timestamps, sorted ascending.
+    TraceColumn timestamps() const noexcept { return timestamps_; }
+
+    /// Latitudes, row-aligned with timestamps().
+    TraceColumn latitudes() const noexcept { return latitudes_; }
+
+    /// Longitudes, row-aligned with timestamps().
+    TraceColumn longitudes() const noexcept { return longitudes_; }
+
+    /// Names of the extra columns (lower-cased, sorted).
+    const std::vector<std::string>& extra_names() const noexcept { return extra_names_; }
+
+    /// Values of extra column @p col (NaN where the row had no numeric value).
+    TraceColumn extra_column(std::size_t col) const { return extra_values_.at(col); }
+
+    /// Index of the extra column called @p name, or -1 if there is none.
+    int extra_index(const std::string& name) const noexcept;
+
+    // ------------------------------------------------------------------ //
+    // Row view (compatibility)
+    // ------------------------------------------------------------------ //
+
+    /// Waypoint @p i assembled from the columns.
+    MobilityPosition waypoint(std::size_t i) const;
+
+    /**
+     * @brief All raw waypoints (sorted by timestamp), assembled from the
+     *        columns.  Builds a copy – prefer the column accessors in hot paths.
+     */
+    std::vector<MobilityPosition> waypoints() const;
 
     /**
      * @brief Linear interpolation / extrapolation at simulation time @p sim_t.
@@ -64,15 +196,88 @@ public:
      */
     MobilityPosition position_at(double sim_t) const noexcept;
 
+    /// As position_at(), resuming the segment search from @p cursor.
+    MobilityPosition position_at(double sim_t, TraceCursor& cursor) const noexcept;
+
+    /**
+     * @brief Allocation-free interpolation at @p sim_t (same rules as
+     *        position_at()).
+     *
+     * @param cursor    Optional segment cursor (see TraceCursor).
+     * @param extra_out Optional output for the extra columns, laid out as
+     *                  extra_names(): extra_out[k] receives column k, NaN if
+     *                  neither surrounding waypoint has a value.  Must hold
+     *                  extra_names().size() doubles.
+     */
+    PositionView view_at(double sim_t, TraceCursor* cursor = nullptr,
+                         double* extra_out = nullptr) const noexcept;
+
+    /**
+     * @brief Interpolation weights at @p sim_t: the position is
+     *        row @p a + @p frac * (row @p b - row @p a).
+     *
+     * Clamped queries give a == b and frac == 0.  Building block for batch
+     * queries over many traces; the trace must not be empty.
+     */
+    void locate(double sim_t, TraceCursor* cursor,
+                std::size_t& a, std::size_t& b, double& frac) const noexcept;
+
 private:
+    friend class TracePack;
+    friend class TraceStream;
+
+    /// Columns while a trace is being built (any order, may hold empty extras).
+    struct Columns {
+        std::vector<double>              ts, lat, lon;
+        std::vector<std::string>         extra_names;
+        std::vector<std::vector<double>> extra;
+
+        void push(double t, double la, double lo, const double* extras);
+    };
+
+    MobilityTrace() = default;
+    /// Take @p cols as the trace (sorted by time); all-NaN extra columns
+    /// are dropped unless @p keep_empty_extras.
+    void adopt(Columns&& cols, bool keep_empty_extras = false);
+    TraceColumn own(std::vector<double>&& values);
+    /// Narrow the columns (views) to @p window; no copy.
+    void clip(const TraceWindow& window) noexcept;
+
     std::string device_name_;
     std::string csv_path_;
-    std::vector<MobilityPosition> waypoints_;
+
+    TraceColumn                      timestamps_;
+    TraceColumn                      latitudes_;
+    TraceColumn                      longitudes_;
+    std::vector<std::string>         extra_names_;
+    std::vector<TraceColumn>         extra_values_;  ///< one column per extra name
+    std::size_t                      malformed_rows_ = 0;
+
+    std::vector<std::vector<double>> owned_;    ///< backing of columns held in memory
+    std::shared_ptr<const void>      mapping_;  ///< backing of columns in a mapped pack
+
+    /// Role of every CSV column, resolved once from the header.
+    struct CsvLayout {
+        static constexpr int IGNORE = -1, TS = -2, LAT = -3, LON = -4, DEVICE = -5;
+
+        std::vector<int>         roles;        ///< per column: a role above or an extra index
+        std::vector<std::string> extra_names;  ///< sorted
+    };
+
+    class WindowFilter;
+    static CsvLayout parse_header(const std::string& line, const std::string& path,
+                                  bool device_column = false);
+    static bool parse_row(const char* first, const char* last, const CsvLayout& layout,
+                          double& ts, double& lat, double& lon, double* extra,
+                          std::string_view* device = nullptr) noexcept;
+    static std::uint64_t read_span(const std::string& path, const CsvLayout& layout,
+                                   std::uint64_t offset, double from, double span,
+                                   double hi, Columns& keep, std::size_t& malformed,
+                                   bool& at_end);
 
     static std::string stem(const std::string& path);
-    static MobilityPosition lerp(const MobilityPosition& a,
-                                  const MobilityPosition& b,
-                                  double t) noexcept;
+    std::size_t segment_of(double sim_t, TraceCursor* cursor) const noexcept;
+    MobilityPosition interpolate(double sim_t, TraceCursor* cursor) const noexcept;
 };
 
 } // namespace enigma::mobility
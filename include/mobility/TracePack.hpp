@@ -0,0 +1,78 @@
+#pragma once
+/**
+ * @file TracePack.hpp
+ * @brief Binary, memory-mappable container for many mobility traces.
+ *
+ * A trace pack holds the columns of every trace of a fleet in one file, laid
+ * out so that MobilityTrace can use them in place: opening a pack maps the
+ * file read-only and points the trace columns into the mapping, with no
+ * parsing and no copy.  The page cache is shared, so parallel simulation
+ * processes opening the same pack share one copy of the data.
+ *
+ * Layout (native byte order, every section 8-byte aligned):
+ * @code
+ *   FileHeader   magic "ENIGMATP", version, byte-order mark, device count,
+ *                offset of the device index
+ *   per device   BlockHeader (rows, extra count, encoding flags, timestamp
+ *                origin/resolution, name sizes), device name, extra names
+ *                ('\n'-separated), then the columns: timestamps,
+ *                latitudes, longitudes, extras
+ *   DeviceIndex  (offset, size) of every device block, in name order
+ * @endcode
+ *
+ * Columns are ``double`` by default.  Optional encodings trade the zero-copy
+ * path for size: ``float`` coordinates / extras (~0.5 m resolution) and
+ * timestamps delta-encoded as ``int32`` ticks of a fixed resolution.  Encoded
+ * columns are decoded into memory when the pack is opened.
+ *
+ * Packs are written by the ``trace_convert`` tool:
+ * @code
+ *   ./trace_convert platforms/coords2/ coords2.emtp
+ * @endcode
+ * and opened by MobilityManager when ``mobility_dir`` names a pack file.
+ */
+
+#include "MobilityTrace.hpp"
+
+#include <string>
+#include <vector>
+
+namespace enigma::mobility {
+
+/// Encodings used when writing a trace pack.
+struct TracePackOptions {
+    bool   float_coords  = false;  ///< Store latitude/longitude as float
+    bool   float_extras  = false;  ///< Store extra columns as float
+    double ts_resolution = 0.0;    ///< > 0: delta-encode timestamps in ticks of this
+                                   ///< many seconds (per trace, only if lossless)
+};
+
+class TracePack {
+public:
+    /// File extension of trace packs.
+    static constexpr const char* EXTENSION = ".emtp";
+
+    /**
+     * @brief Write @p traces to @p path.
+     * Throws std::runtime_error on I/O failure.
+     */
+    static void write(const std::string& path,
+                      const std::vector<const MobilityTrace*>& traces,
+                      const TracePackOptions& options = {});
+
+    /**
+     * @brief Map the pack at @p path and return its traces (in name order).
+     *
+     * The traces share the mapping, which is released with the last of them.
+     * Mapped columns are narrowed to @p window without copying; encoded
+     * columns are decoded whole.
+     * Throws std::runtime_error if the file is not a valid pack.
+     */
+    static std::vector<MobilityTrace> open(const std::string& path,
+                                           const TraceWindow& window = {});
+
+    /// True if @p path starts with the trace pack magic.
+    static bool is_pack(const std::string& path);
+};
+
+} // namespace enigma::mobility
@@ -0,0 +1,90 @@
+#pragma once
+/**
+ * @file TraceStream.hpp
+ * @brief Pages a long CSV trace in chunk by chunk as simulated time advances.
+ *
+ * A trace spanning weeks at 1 Hz does not need to be resident for a
+ * simulation covering hours.  A TraceStream keeps one chunk of the trace in
+ * memory (a MobilityTrace covering @c chunk_s trace seconds) and reads the
+ * next one from where the previous stopped once simulated time passes its
+ * last waypoint, so memory is bounded by the chunk length, not the trace
+ * length.
+ *
+ * Streaming relies on the rows being in time order (it throws otherwise)
+ * and on queries moving forward: a query before the resident chunk sees its
+ * first waypoint.  Every chunk keeps all extra columns of the header, so the
+ * column layout does not change from one chunk to the next, and ends after
+ * all rows sharing its last timestamp, so duplicate timestamps resolve as in
+ * a whole-trace load.
+ *
+ * @code
+ *   TraceStream stream("coords/bus_0.csv", 600.0);   // 10 min chunks
+ *   MobilityTrace resident = stream.first();
+ *   for (double t = 0; t < 86400; t += 1.0) {
+ *       stream.page(t, resident);
+ *       auto pos = resident.view_at(t);
+ *   }
+ * @endcode
+ */
+
+#include "MobilityTrace.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace enigma::mobility {
+
+class TraceStream {
+public:
+    /**
+     * @brief Open @p csv_path for streaming in chunks of @p chunk_s trace
+     *        seconds, restricted to @p window.
+     *
+     * Reads the header and the last row (for t_max()).
+     * Throws std::runtime_error on I/O failure or a missing column.
+     */
+    TraceStream(const std::string& csv_path, double chunk_s, const TraceWindow& window = {});
+    ~TraceStream();
+
+    TraceStream(const TraceStream&) = delete;
+    TraceStream& operator=(const TraceStream&) = delete;
+
+    /// The first chunk (from the window begin).  Call once, before page().
+    /// Throws std::runtime_error if the trace has no valid row.
+    MobilityTrace first();
+
+    /**
+     * @brief Replace @p resident by the chunk covering @p sim_t once
+     *        @p sim_t has passed its last waypoint.
+     *
+     * @return true if @p resident was replaced.
+     * Throws std::runtime_error on I/O failure or rows out of time order;
+     * the stream then stops paging and @p resident is left as it was.
+     */
+    bool page(double sim_t, MobilityTrace& resident);
+
+    /// Last timestamp of the trace (capped at the window end).
+    double t_max() const noexcept { return t_max_; }
+
+    /// True once the end of the file (or of the window) has been read.
+    bool done() const noexcept { return done_; }
+
+    /// Chunks read so far.
+    std::size_t chunks() const noexcept { return chunks_; }
+
+private:
+    MobilityTrace read(double from, MobilityTrace::Columns&& keep);
+
+    std::string                                     path_;
+    double                                          chunk_s_;
+    TraceWindow                                     window_;
+    std::unique_ptr<const MobilityTrace::CsvLayout> layout_;
+    std::uint64_t                                   offset_    = 0;  ///< next unread row
+    bool                                            done_      = false;
+    double                                          t_max_;
+    std::size_t                                     malformed_ = 0;
+    std::size_t                                     chunks_    = 0;
+};
+
+} // namespace enigma::mobility
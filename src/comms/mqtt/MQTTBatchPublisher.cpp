@@ -0,0 +1,220 @@
+#include "comms/mqtt/MQTTBatchPublisher.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+XBT_LOG_NEW_DEFAULT_CATEGORY(mqtt_batch_publisher, "MQTT Batching Publisher");
+
+namespace enigma {
+namespace mqtt {
+
+namespace sg4 = simgrid::s4u;
+
+MQTTBatchPublisher::MQTTBatchPublisher(const std::string& broker,
+                                       const std::string& pub_id,
+                                       const MQTTBatchConfig& config)
+    : state(std::make_shared<State>()) {
+    
+    auto* host = sg4::this_actor::get_host();
+    
+    // Generate publisher ID if not provided
+    if (pub_id.empty()) {
+        state->publisher_id = std::string(host->get_cname()) + "_batchpub_" +
+                              std::to_string(sg4::this_actor::get_pid());
+    } else {
+        state->publisher_id = pub_id;
+    }
+    
+    state->default_broker = broker;
+    state->config = config;
+    state->mutex = sg4::Mutex::create();
+    state->cond = sg4::ConditionVariable::create();
+    
+    // The flush actor is a daemon so a publisher that is never closed
+    // does not keep the simulation alive
+    auto shared = state;
+    host->add_actor(state->publisher_id + "_flush", [shared]() { flush_loop(shared); })
+        ->daemonize();
+    
+    XBT_DEBUG("MQTT Batching Publisher '%s' initialized (broker: %s, %zu msgs / %.3f s)",
+              state->publisher_id.c_str(), broker.c_str(),
+              config.max_messages, config.max_delay);
+}
+
+MQTTBatchPublisher::~MQTTBatchPublisher() {
+    if (state && !state->closed) {
+        close();
+    }
+}
+
+void MQTTBatchPublisher::publish(const std::string& topic,
+                                 const std::string& payload,
+                                 size_t size,
+                                 int qos) {
+    publish_to(state->default_broker, topic, payload, size, qos);
+}
+
+void MQTTBatchPublisher::publish_to(const std::string& broker,
+                                    const std::string& topic,
+                                    const std::string& payload,
+                                    size_t size,
+                                    int qos) {
+    std::unique_lock<sg4::Mutex> lock(*state->mutex);
+    
+    Batch& batch = state->batches[broker];
+    if (batch.messages.empty()) {
+        batch.oldest = sg4::Engine::get_clock();
+    }
+    batch.messages.push_back(
+        std::make_shared<MQTTMessage>(topic, payload, size, state->publisher_id, qos));
+    batch.bytes += size;
+    
+    const auto& config = state->config;
+    bool full = batch.messages.size() >= config.max_messages ||
+                (config.max_bytes > 0 && batch.bytes >= config.max_bytes);
+    
+    // Wake the flush actor when a new deadline starts or a batch is full
+    if (full || batch.messages.size() == 1) {
+        state->cond->notify_all();
+    }
+}
+
+void MQTTBatchPublisher::flush() {
+    std::unique_lock<sg4::Mutex> lock(*state->mutex);
+    state->flush_requested = true;
+    state->cond->notify_all();
+}
+
+void MQTTBatchPublisher::close() {
+    std::unique_lock<sg4::Mutex> lock(*state->mutex);
+    state->closed = true;
+    state->cond->notify_all();
+    
+    while (!state->finished) {
+        state->cond->wait(lock);
+    }
+}
+
+void MQTTBatchPublisher::flush_loop(std::shared_ptr<State> state) {
+    // One publisher per destination broker, owned by this actor so that
+    // acknowledgements are received here
+    std::map<std::string, std::unique_ptr<MQTTPublisher>> publishers;
+    const auto& config = state->config;
+    
+    std::unique_lock<sg4::Mutex> lock(*state->mutex);
+    
+    while (true) {
+        double now = sg4::Engine::get_clock();
+        double next_deadline = std::numeric_limits<double>::infinity();
+        std::vector<std::pair<std::string, Batch>> ready;
+        
+        for (auto& [broker, batch] : state->batches) {
+            if (batch.messages.empty()) continue;
+            
+            bool full = batch.messages.size() >= config.max_messages ||
+                        (config.max_bytes > 0 && batch.bytes >= config.max_bytes);
+            double due = batch.oldest + config.max_delay;
+            
+            if (full || now >= due || state->flush_requested || state->closed) {
+                ready.emplace_back(broker, std::move(batch));
+                batch = Batch();
+            } else {
+                next_deadline = std::min(next_deadline, due);
+            }
+        }
+        state->flush_requested = false;
+        
+        if (ready.empty()) {
+            if (state->closed) {
+                break;
+            }
+            if (next_deadline < std::numeric_limits<double>::infinity()) {
+                state->cond->wait_until(lock, next_deadline);
+            } else {
+                state->cond->wait(lock);
+            }
+            continue;
+        }
+        
+        // Account for the batches before releasing the lock
+        auto& stats = state->stats;
+        for (const auto& [broker, batch] : ready) {
+            stats.batches++;
+            stats.messages += static_cast<int>(batch.messages.size());
+            stats.bytes += batch.bytes;
+            stats.max_batch_messages = std::max(stats.max_batch_messages, batch.messages.size());
+            stats.max_batch_bytes = std::max(stats.max_batch_bytes, batch.bytes);
+            for (const auto& msg : batch.messages) {
+                double added = now - msg->timestamp;
+                stats.total_added_latency += added;
+                stats.max_added_latency = std::max(stats.max_added_latency, added);
+            }
+        }
+        
+        lock.unlock();
+        
+        // A failure must not end this actor: close() waits for it to finish
+        std::vector<size_t> failed;
+        for (const auto& [broker, batch] : ready) {
+            try {
+                auto& publisher = publishers[broker];
+                if (!publisher) {
+                    std::string id = broker == state->default_broker
+                                         ? state->publisher_id
+                                         : state->publisher_id + "@" + broker;
+                    publisher = std::make_unique<MQTTPublisher>(broker, id);
+                }
+                
+                XBT_DEBUG("Flushing %zu messages (%zu bytes) to broker '%s'",
+                          batch.messages.size(), batch.bytes, broker.c_str());
+                publisher->publish_batch(batch.messages);
+            } catch (const std::exception& e) {
+                XBT_WARN("Dropping batch of %zu messages for broker '%s': %s",
+                         batch.messages.size(), broker.c_str(), e.what());
+                publishers.erase(broker);
+                failed.push_back(batch.messages.size());
+            }
+        }
+        
+        lock.lock();
+        for (size_t n : failed) {
+            stats.failed_batches++;
+            stats.failed_messages += static_cast<int>(n);
+        }
+    }
+    
+    lock.unlock();
+    
+    // Drain outstanding QoS 1/2 flows before reporting completion
+    for (auto& [broker, publisher] : publishers) {
+        publisher->wait_for_acks();
+    }
+    
+    lock.lock();
+    state->finished = true;
+    state->cond->notify_all();
+}
+
+void MQTTBatchPublisher::print_stats() const {
+    const auto& stats = state->stats;
+    
+    XBT_INFO("=== MQTT Batching Publisher Statistics (%s) ===", state->publisher_id.c_str());
+    XBT_INFO("  Batches sent:  %d", stats.batches);
+    XBT_INFO("  Messages sent: %d (%zu bytes)", stats.messages, stats.bytes);
+    if (stats.batches > 0) {
+        XBT_INFO("  Batch size: mean %.2f msgs, max %zu msgs / %zu bytes",
+                 static_cast<double>(stats.messages) / stats.batches,
+                 stats.max_batch_messages, stats.max_batch_bytes);
+    }
+    if (stats.failed_batches > 0) {
+        XBT_INFO("  Failed batches: %d (%d messages)", stats.failed_batches,
+                 stats.failed_messages);
+    }
+    if (stats.messages > 0) {
+        XBT_INFO("  Added latency: mean %.6f s, max %.6f s",
+                 stats.total_added_latency / stats.messages, stats.max_added_latency);
+    }
+}
+
+} // namespace mqtt
+} // namespace enigma
@@ -0,0 +1,160 @@
+#include "comms/mqtt/MQTTBridge.hpp"
+#include "comms/mqtt/MQTTSubscriber.hpp"
+#include <algorithm>
+
+XBT_LOG_NEW_DEFAULT_CATEGORY(mqtt_bridge, "MQTT Bridge");
+
+namespace enigma {
+namespace mqtt {
+
+namespace sg4 = simgrid::s4u;
+
+MQTTBridge::MQTTBridge(const MQTTBridgeConfig& cfg)
+    : config(cfg), pending_bytes(0), pending_since(0),
+      messages_received(0), messages_forwarded(0), messages_dropped_loop(0),
+      transfers(0), bytes_forwarded(0) {
+    remote_mbox = sg4::Mailbox::by_name(MQTTBroker::get_broker_mailbox(config.remote_broker));
+}
+
+void MQTTBridge::operator()() {
+    sg4::Host* host = sg4::this_actor::get_host();
+    XBT_INFO("MQTT Bridge '%s' started on host '%s' (%s -> %s, %zu rules)",
+             config.bridge_name.c_str(), host->get_cname(),
+             config.local_broker.c_str(), config.remote_broker.c_str(),
+             config.rules.size());
+    
+    // Subscribe at QoS 2 so bridged messages keep their original QoS; the
+    // bridge -> remote broker hop itself is not acknowledged
+    MQTTSubscriber subscriber(config.local_broker, config.bridge_name);
+    for (const auto& rule : config.rules) {
+        subscriber.subscribe(rule.local_prefix + rule.topic, 2);
+    }
+    
+    while (true) {
+        // Wait at most until the oldest batched message must leave
+        double timeout = config.idle_timeout;
+        if (!pending.empty()) {
+            timeout = pending_since + config.batch_timeout - sg4::Engine::get_clock();
+            if (timeout <= 0) {
+                flush();
+                continue;
+            }
+        }
+        
+        auto msg = subscriber.receive(timeout);
+        
+        if (msg) {
+            handle_message(msg);
+        } else if (!pending.empty()) {
+            flush();
+        } else {
+            XBT_INFO("Bridge '%s' idle for %.2f s, stopping",
+                     config.bridge_name.c_str(), config.idle_timeout);
+            break;
+        }
+    }
+    
+    flush();
+    print_stats();
+    XBT_INFO("MQTT Bridge '%s' terminated", config.bridge_name.c_str());
+}
+
+void MQTTBridge::handle_message(const std::shared_ptr<MQTTMessage>& msg) {
+    messages_received++;
+    
+    const MQTTBridgeRule* rule = find_rule(msg->topic);
+    if (rule == nullptr) {
+        XBT_DEBUG("No bridge rule for topic '%s'", msg->topic.c_str());
+        return;
+    }
+    
+    // Loop prevention: never send a message back to a broker it came through
+    const auto& via = msg->via;
+    if (std::find(via.begin(), via.end(), config.remote_broker) != via.end() ||
+        static_cast<int>(via.size()) >= config.max_hops) {
+        messages_dropped_loop++;
+        XBT_DEBUG("Dropping message on '%s' (already visited '%s')",
+                  msg->topic.c_str(), config.remote_broker.c_str());
+        return;
+    }
+    
+    // The forwarded copy keeps the original timestamp and publisher so
+    // end-to-end latency stays measurable at the remote subscribers
+    auto fwd = std::make_shared<MQTTMessage>(*msg);
+    fwd->topic = rule->remote_prefix + msg->topic.substr(rule->local_prefix.size());
+    fwd->via.push_back(config.local_broker);
+    
+    forward(fwd);
+}
+
+void MQTTBridge::forward(std::shared_ptr<MQTTMessage> msg) {
+    if (config.batch_max_messages <= 1) {
+        XBT_DEBUG("Forwarding '%s' to broker '%s'",
+                  msg->topic.c_str(), config.remote_broker.c_str());
+        auto* ctrl_msg = MQTTControlMessage::publish(msg);
+        size_t size = ctrl_msg->wire_size();
+        remote_mbox->put(ctrl_msg, size);
+        transfers++;
+        messages_forwarded++;
+        bytes_forwarded += size;
+        return;
+    }
+    
+    if (pending.empty()) {
+        pending_since = sg4::Engine::get_clock();
+    }
+    pending_bytes += msg->size;
+    pending.push_back(std::move(msg));
+    
+    if (pending.size() >= config.batch_max_messages ||
+        (config.batch_max_bytes > 0 && pending_bytes >= config.batch_max_bytes)) {
+        flush();
+    }
+}
+
+void MQTTBridge::flush() {
+    if (pending.empty()) {
+        return;
+    }
+    
+    size_t count = pending.size();
+    auto* ctrl_msg = MQTTControlMessage::publish_batch(std::move(pending));
+    size_t size = ctrl_msg->wire_size();
+    
+    XBT_DEBUG("Flushing batch of %zu messages (%zu bytes) to broker '%s'",
+              count, size, config.remote_broker.c_str());
+    
+    remote_mbox->put(ctrl_msg, size);
+    pending.clear();
+    pending_bytes = 0;
+    
+    transfers++;
+    messages_forwarded += static_cast<int>(count);
+    bytes_forwarded += size;
+}
+
+const MQTTBridgeRule* MQTTBridge::find_rule(const std::string& topic) const {
+    for (const auto& rule : config.rules) {
+        if (topic.compare(0, rule.local_prefix.size(), rule.local_prefix) == 0 &&
+            MQTTBroker::topic_matches(rule.local_prefix + rule.topic, topic)) {
+            return &rule;
+        }
+    }
+    return nullptr;
+}
+
+void MQTTBridge::print_stats() const {
+    XBT_INFO("=== MQTT Bridge Statistics (%s) ===", config.bridge_name.c_str());
+    XBT_INFO("  Messages received:  %d", messages_received);
+    XBT_INFO("  Messages forwarded: %d", messages_forwarded);
+    XBT_INFO("  Dropped (loop):     %d", messages_dropped_loop);
+    XBT_INFO("  Transfers to '%s': %d (%zu bytes)",
+             config.remote_broker.c_str(), transfers, bytes_forwarded);
+    if (transfers > 0) {
+        XBT_INFO("  Messages per transfer: %.2f",
+                 static_cast<double>(messages_forwarded) / transfers);
+    }
+}
+
+} // namespace mqtt
+} // namespace enigma
@@ -1,5 +1,8 @@
 #include "comms/mqtt/MQTTBroker.hpp"
 #include <algorithm>
+#include <functional>
+#include <limits>
+#include <string_view>
 
 XBT_LOG_NEW_DEFAULT_CATEGORY(mqtt_broker, "MQTT Broker");
 
@@ -8,9 +11,19 @@ namespace mqtt {
 
 namespace sg4 = simgrid::s4u;
 
-MQTTBroker::MQTTBroker(const std::string& name)
-    : broker_name(name), messages_published(0), messages_delivered(0), running(true) {
+MQTTBroker::MQTTBroker(const std::string& name, const MQTTBrokerConfig& cfg)
+    : broker_name(name), config(cfg), stored_bytes(0), messages_published(0),
+      duplicates_suppressed(0), retransmissions(0), subscribers_disconnected(0), connects(0),
+      pings(0), messages_stored(0), messages_replayed(0), storage_evictions(0),
+      storage_rejected(0), max_stored_bytes(0), messages_rate_rejected(0),
+      messages_rate_delayed(0), rate_delay(0), busy_time(0),
+      traffic_stats(std::make_shared<MQTTBrokerStats>(sg4::Engine::get_clock())),
+      last_depth_sample(-std::numeric_limits<double>::infinity()), running(true) {
     control_mbox = sg4::Mailbox::by_name(get_broker_mailbox(name));
+    
+    for (const auto& op_cfg : config.operators) {
+        operators.emplace_back(op_cfg);
+    }
 }
 
 void MQTTBroker::operator()() {
@@ -18,59 +31,198 @@ void MQTTBroker::operator()() {
     XBT_INFO("MQTT Broker '%s' started on host '%s'", 
              broker_name.c_str(), host->get_cname());
     
+    start_workers();
+    
     while (running) {
-        // Receive control message
-        auto* ctrl_msg = control_mbox->get<MQTTControlMessage>();
+        // Receive control message, waking up for pending retransmissions
+        // and operator windows
+        MQTTControlMessage* ctrl_msg = nullptr;
+        double deadline = std::min({next_retransmit_deadline(), next_operator_deadline(),
+                                    next_held_deadline()});
         
-        switch (ctrl_msg->type) {
-            case MQTTControlMessage::Type::SUBSCRIBE:
-                handle_subscribe(ctrl_msg->topic, ctrl_msg->subscriber);
-                break;
-                
-            case MQTTControlMessage::Type::UNSUBSCRIBE:
-                handle_unsubscribe(ctrl_msg->topic, ctrl_msg->subscriber);
-                break;
-                
-            case MQTTControlMessage::Type::PUBLISH:
-                handle_publish(ctrl_msg->message);
-                break;
-                
-            case MQTTControlMessage::Type::SHUTDOWN:
-                XBT_INFO("Broker shutdown requested");
-                running = false;
-                break;
-                
-            default:
-                XBT_WARN("Unknown control message type");
-                break;
+        try {
+            if (deadline < std::numeric_limits<double>::infinity()) {
+                double timeout = std::max(deadline - sg4::Engine::get_clock(), 1e-6);
+                ctrl_msg = control_mbox->get<MQTTControlMessage>(timeout);
+            } else {
+                ctrl_msg = control_mbox->get<MQTTControlMessage>();
+            }
+        } catch (const simgrid::TimeoutException&) {
+            release_held();
+            flush_operators();
+            retransmit_expired();
+            process_disconnects();
+            sample_queue_depth();
+            continue;
         }
         
-        delete ctrl_msg;
+        // Publishes go to the worker of their publisher, which keeps the
+        // messages of one publisher in order
+        bool is_publish = ctrl_msg->type == MQTTControlMessage::Type::PUBLISH ||
+                          ctrl_msg->type == MQTTControlMessage::Type::PUBLISH_BATCH;
+        if (is_publish && !workers.empty()) {
+            dispatch(ctrl_msg);
+        } else {
+            handle_control(*ctrl_msg);
+            delete ctrl_msg;
+        }
+        
+        release_held();
+        flush_operators();
+        retransmit_expired();
+        process_disconnects();
+        sample_queue_depth();
     }
     
+    stop_workers();
+    close_outboxes();
     print_stats();
+    if (!config.stats.export_prefix.empty()) {
+        export_stats();
+    }
     XBT_INFO("MQTT Broker '%s' terminated", broker_name.c_str());
 }
 
-void MQTTBroker::handle_subscribe(const std::string& topic, const std::string& subscriber) {
+void MQTTBroker::handle_control(const MQTTControlMessage& ctrl_msg) {
+    // Publishes are charged per contained message in handle_publish()
+    if (ctrl_msg.type != MQTTControlMessage::Type::PUBLISH &&
+        ctrl_msg.type != MQTTControlMessage::Type::PUBLISH_BATCH) {
+        charge(config.service.cost_per_message);
+    }
+    
+    switch (ctrl_msg.type) {
+        case MQTTControlMessage::Type::CONNECT:
+            handle_connect(ctrl_msg.client, ctrl_msg.clean_start);
+            break;
+            
+        case MQTTControlMessage::Type::PINGREQ:
+            pings++;
+            send_to_client(ctrl_msg.client,
+                           new MQTTControlMessage(MQTTControlMessage::Type::PINGRESP));
+            break;
+            
+        case MQTTControlMessage::Type::DISCONNECT:
+            handle_disconnect(ctrl_msg.client);
+            break;
+            
+        case MQTTControlMessage::Type::SUBSCRIBE:
+            handle_subscribe(ctrl_msg.topic, ctrl_msg.subscriber, ctrl_msg.qos);
+            break;
+            
+        case MQTTControlMessage::Type::UNSUBSCRIBE:
+            handle_unsubscribe(ctrl_msg.topic, ctrl_msg.subscriber);
+            break;
+            
+        case MQTTControlMessage::Type::PUBLISH:
+            handle_publish(ctrl_msg.message, ctrl_msg.client, ctrl_msg.packet_id);
+            break;
+            
+        case MQTTControlMessage::Type::PUBLISH_BATCH:
+            XBT_DEBUG("Unpacking batch of %zu messages", ctrl_msg.batch.size());
+            for (size_t i = 0; i < ctrl_msg.batch.size(); i++) {
+                int packet_id = i < ctrl_msg.packet_ids.size() ? ctrl_msg.packet_ids[i] : 0;
+                handle_publish(ctrl_msg.batch[i], ctrl_msg.client, packet_id);
+            }
+            break;
+            
+        case MQTTControlMessage::Type::PUBREL:
+            handle_pubrel(ctrl_msg.client, ctrl_msg.packet_id);
+            break;
+            
+        case MQTTControlMessage::Type::PUBACK:
+        case MQTTControlMessage::Type::PUBREC:
+        case MQTTControlMessage::Type::PUBCOMP:
+            handle_subscriber_ack(ctrl_msg);
+            break;
+            
+        case MQTTControlMessage::Type::SHUTDOWN:
+            XBT_INFO("Broker shutdown requested");
+            running = false;
+            break;
+            
+        default:
+            XBT_WARN("Unknown control message type");
+            break;
+    }
+}
+
+void MQTTBroker::handle_connect(const std::string& client, bool clean_start) {
+    connects++;
+    if (!connected_clients.insert(client).second) {
+        XBT_DEBUG("Client '%s' reconnected", client.c_str());
+    }
+    
+    auto session_it = sessions.find(client);
+    bool had_session = session_it != sessions.end() && session_it->second.persistent;
+    
+    // A clean start discards the previous persistent session
+    if (clean_start && had_session) {
+        remove_client(client);
+    }
+    
+    auto* connack = new MQTTControlMessage(MQTTControlMessage::Type::CONNACK);
+    connack->session_present = had_session && !clean_start;
+    send_to_client(client, connack);
+    
+    if (!clean_start) {
+        Session& session = sessions[client];
+        session.persistent = true;
+        if (session.offline) {
+            resume_session(client);
+        }
+    }
+}
+
+void MQTTBroker::handle_disconnect(const std::string& client) {
+    XBT_DEBUG("Client '%s' disconnected", client.c_str());
+    connected_clients.erase(client);
+    
+    auto session_it = sessions.find(client);
+    if (session_it != sessions.end() && session_it->second.persistent) {
+        XBT_INFO("Client '%s' offline, keeping its session", client.c_str());
+        session_it->second.offline = true;
+        return;
+    }
+    
+    // Clean session: subscriptions end with the connection
+    remove_client(client);
+}
+
+void MQTTBroker::handle_subscribe(const std::string& topic, const std::string& subscriber,
+                                  int qos) {
+    // A subscriber dropped for overflowing its queue starts over
+    auto outbox_it = outboxes.find(subscriber);
+    if (outbox_it != outboxes.end() && outbox_it->second->disconnected) {
+        open_outbox(subscriber);
+    }
+    
     auto& subs = subscriptions[topic];
+    if (subs.empty() && is_pattern(topic)) {
+        pattern_filters.insert(topic);
+    }
     
     // Check if already subscribed
-    if (std::find(subs.begin(), subs.end(), subscriber) == subs.end()) {
-        subs.push_back(subscriber);
+    auto it = std::find_if(subs.begin(), subs.end(),
+                           [&](const Subscription& s) { return s.subscriber == subscriber; });
+    if (it == subs.end()) {
+        subs.push_back({subscriber, std::clamp(qos, 0, 2)});
         XBT_INFO("Subscriber '%s' subscribed to topic '%s' (%zu total subscribers)",
                  subscriber.c_str(), topic.c_str(), subs.size());
     } else {
+        it->qos = std::clamp(qos, 0, 2);
         XBT_DEBUG("Subscriber '%s' already subscribed to topic '%s'",
                   subscriber.c_str(), topic.c_str());
     }
+    
+    send_retained(topic, subscriber, std::clamp(qos, 0, 2));
 }
 
 void MQTTBroker::handle_unsubscribe(const std::string& topic, const std::string& subscriber) {
     auto it = subscriptions.find(topic);
     if (it != subscriptions.end()) {
         auto& subs = it->second;
-        auto sub_it = std::find(subs.begin(), subs.end(), subscriber);
+        auto sub_it = std::find_if(subs.begin(), subs.end(),
+                                   [&](const Subscription& s) { return s.subscriber == subscriber; });
         
         if (sub_it != subs.end()) {
             subs.erase(sub_it);
@@ -79,39 +231,949 @@ void MQTTBroker::handle_unsubscribe(const std::string& topic, const std::string&
             
             // Remove topic if no more subscribers
             if (subs.empty()) {
-                subscriptions.erase(it);
+                erase_filter(it);
                 XBT_DEBUG("Topic '%s' removed (no subscribers)", topic.c_str());
             }
         }
     }
 }
 
-void MQTTBroker::handle_publish(std::shared_ptr<MQTTMessage> msg) {
+void MQTTBroker::handle_publish(std::shared_ptr<MQTTMessage> msg,
+                                const std::string& client, int packet_id) {
+    bool acknowledged = !client.empty() && packet_id != 0;
+    
+    // QoS 2: a retransmitted PUBLISH that was already received is only
+    // acknowledged again, never routed twice
+    if (acknowledged && msg->qos == 2) {
+        auto key = std::make_pair(client, packet_id);
+        if (qos2_received.count(key)) {
+            duplicates_suppressed++;
+            XBT_DEBUG("Duplicate QoS 2 publish %d from '%s' suppressed",
+                      packet_id, client.c_str());
+            send_to_client(client, MQTTControlMessage::ack(
+                MQTTControlMessage::Type::PUBREC, broker_name, packet_id));
+            return;
+        }
+        qos2_received.insert(key);
+    }
+    
+    // Held publishes are acknowledged right away, like rejected ones, so
+    // the client does not retry
+    double release_at = 0;
+    if (admit(*msg, release_at)) {
+        // Behind an earlier held message of the same publisher, even with
+        // tokens to spare, so its messages stay in order
+        if (release_at > sg4::Engine::get_clock() || held.count(msg->publisher)) {
+            hold(msg, release_at);
+        } else {
+            accept(msg);
+        }
+    }
+    
+    if (acknowledged && msg->qos == 1) {
+        send_to_client(client, MQTTControlMessage::ack(
+            MQTTControlMessage::Type::PUBACK, broker_name, packet_id));
+    } else if (acknowledged && msg->qos == 2) {
+        send_to_client(client, MQTTControlMessage::ack(
+            MQTTControlMessage::Type::PUBREC, broker_name, packet_id));
+    }
+}
+
+bool MQTTBroker::admit(const MQTTMessage& msg, double& release_at) {
+    const auto& limits = config.rate_limits;
+    double now = sg4::Engine::get_clock();
+    release_at = now;
+    
+    // Buckets this message has to take a token from
+    std::vector<std::pair<TokenBucket*, const MQTTRateLimit*>> buckets;
+    auto add_bucket = [&](TokenBucket* bucket, const MQTTRateLimit& limit, bool created) {
+        if (created) {
+            *bucket = TokenBucket{limit.burst, now};
+        }
+        buckets.emplace_back(bucket, &limit);
+    };
+    
+    auto override_it = limits.publisher_overrides.find(msg.publisher);
+    const MQTTRateLimit& publisher_limit = override_it != limits.publisher_overrides.end()
+                                               ? override_it->second
+                                               : limits.per_publisher;
+    if (publisher_limit.rate > 0) {
+        auto [it, created] = publisher_buckets.try_emplace(msg.publisher);
+        add_bucket(&it->second, publisher_limit, created);
+    }
+    for (const auto& [filter, limit] : limits.topics) {
+        if (limit.rate <= 0 || !topic_matches(filter, msg.topic)) continue;
+        auto [it, created] = topic_buckets.try_emplace(std::make_pair(filter, msg.topic));
+        add_bucket(&it->second, limit, created);
+    }
+    
+    if (buckets.empty()) {
+        return true;
+    }
+    
+    for (auto& [bucket, limit] : buckets) {
+        bucket->tokens = std::min(limit->burst,
+                                  bucket->tokens + (now - bucket->updated) * limit->rate);
+        bucket->updated = now;
+    }
+    
+    // Nothing is taken unless every bucket admits the message
+    double wait = 0;
+    for (const auto& [bucket, limit] : buckets) {
+        if (bucket->tokens >= 1) continue;
+        
+        if (limit->action == MQTTRateLimitAction::REJECT) {
+            messages_rate_rejected++;
+            throttled_publishers[msg.publisher]++;
+            XBT_DEBUG("Rate limit: rejected message of '%s' on '%s'",
+                      msg.publisher.c_str(), msg.topic.c_str());
+            return false;
+        }
+        wait = std::max(wait, (1 - bucket->tokens) / limit->rate);
+    }
+    
+    if (wait > 0) {
+        messages_rate_delayed++;
+        throttled_publishers[msg.publisher]++;
+        rate_delay += wait;
+        release_at = now + wait;
+        XBT_DEBUG("Rate limit: holding message of '%s' on '%s' for %.6f s",
+                  msg.publisher.c_str(), msg.topic.c_str(), wait);
+    }
+    
+    // A held message takes its token now: the debt pushes the release of
+    // the following messages further out, and is repaid by later refills
+    for (auto& [bucket, limit] : buckets) {
+        bucket->tokens -= 1;
+    }
+    return true;
+}
+
+void MQTTBroker::accept(std::shared_ptr<MQTTMessage> msg) {
     messages_published++;
+    traffic_stats->record_publish(msg->topic, msg->size, sg4::Engine::get_clock());
+    
+    if (msg->retain) {
+        store_retained(msg);
+    }
     
+    // Operators consuming the topic replace the raw stream
+    if (!apply_operators(msg)) {
+        route(msg);
+    }
+}
+
+void MQTTBroker::hold(std::shared_ptr<MQTTMessage> msg, double release_at) {
+    auto& queue = held[msg->publisher];
+    if (!queue.empty()) {
+        release_at = std::max(release_at, queue.back().first);
+    }
+    queue.emplace_back(release_at, std::move(msg));
+}
+
+void MQTTBroker::release_held() {
+    double now = sg4::Engine::get_clock();
+    
+    // Collect first: routing may block and let workers hold more messages
+    std::vector<std::shared_ptr<MQTTMessage>> ready;
+    for (auto it = held.begin(); it != held.end();) {
+        auto& queue = it->second;
+        while (!queue.empty() && queue.front().first <= now) {
+            ready.push_back(std::move(queue.front().second));
+            queue.pop_front();
+        }
+        it = queue.empty() ? held.erase(it) : std::next(it);
+    }
+    
+    for (const auto& msg : ready) {
+        accept(msg);
+    }
+}
+
+double MQTTBroker::next_held_deadline() const {
+    double deadline = std::numeric_limits<double>::infinity();
+    for (const auto& [publisher, queue] : held) {
+        deadline = std::min(deadline, queue.front().first);
+    }
+    return deadline;
+}
+
+void MQTTBroker::route(std::shared_ptr<MQTTMessage> msg) {
     XBT_INFO("Publishing message to topic '%s' (size: %zu bytes, from: %s)",
              msg->topic.c_str(), msg->size, msg->publisher.c_str());
     
-    // Find subscribers for this topic
-    auto it = subscriptions.find(msg->topic);
-    if (it == subscriptions.end() || it->second.empty()) {
+    // Collect matching subscribers (a subscriber matching through several
+    // filters receives the message once, at the highest granted QoS)
+    std::vector<Subscription> targets;
+    auto add_target = [&targets](const Subscription& sub) {
+        auto it = std::find_if(targets.begin(), targets.end(),
+                               [&](const Subscription& s) { return s.subscriber == sub.subscriber; });
+        if (it == targets.end()) {
+            targets.push_back(sub);
+        } else {
+            it->qos = std::max(it->qos, sub.qos);
+        }
+    };
+    
+    std::string group;
+    std::string topic_filter;
+    auto add_filter = [&](const std::string& filter, const std::vector<Subscription>& subs) {
+        // Shared subscription: exactly one member of the group
+        if (parse_shared_subscription(filter, group, topic_filter)) {
+            const Subscription& member = select_shared(filter, subs, *msg);
+            share_deliveries[filter][member.subscriber]++;
+            add_target(member);
+            return;
+        }
+        
+        for (const auto& sub : subs) {
+            add_target(sub);
+        }
+    };
+    
+    // Plain filters only match the identical topic; patterns are scanned
+    auto exact = subscriptions.find(msg->topic);
+    if (exact != subscriptions.end() && !pattern_filters.count(exact->first)) {
+        add_filter(exact->first, exact->second);
+    }
+    for (const auto& filter : pattern_filters) {
+        if (!topic_matches(filter, msg->topic)) continue;
+        add_filter(filter, subscriptions.at(filter));
+    }
+    
+    // Filters evaluated: one exact lookup plus every pattern
+    const auto& service = config.service;
+    size_t evaluated = pattern_filters.size() + 1;
+    charge(service.cost_per_message +
+           service.cost_per_byte * static_cast<double>(msg->size) +
+           service.cost_per_match * static_cast<double>(evaluated) +
+           service.cost_per_delivery * static_cast<double>(targets.size()));
+    
+    if (targets.empty()) {
         XBT_DEBUG("No subscribers for topic '%s'", msg->topic.c_str());
+    } else {
+        // Deliver to all subscribers
+        for (const auto& sub : targets) {
+            deliver(sub.subscriber, msg, std::min(msg->qos, sub.qos));
+        }
+        XBT_INFO("Message delivered to %zu subscribers", targets.size());
+    }
+}
+
+void MQTTBroker::handle_pubrel(const std::string& client, int packet_id) {
+    qos2_received.erase(std::make_pair(client, packet_id));
+    send_to_client(client, MQTTControlMessage::ack(
+        MQTTControlMessage::Type::PUBCOMP, broker_name, packet_id));
+}
+
+void MQTTBroker::handle_subscriber_ack(const MQTTControlMessage& ack) {
+    auto session_it = sessions.find(ack.client);
+    if (session_it == sessions.end()) return;
+    Session& session = session_it->second;
+    
+    auto it = session.inflight.find(ack.packet_id);
+    if (it == session.inflight.end()) {
+        XBT_DEBUG("Stale acknowledgement %d from '%s'", ack.packet_id, ack.client.c_str());
+        return;
+    }
+    
+    if (ack.type == MQTTControlMessage::Type::PUBREC) {
+        // QoS 2: release the message and wait for PUBCOMP
+        it->second.released = true;
+        it->second.sent_at = sg4::Engine::get_clock();
+        send_to_client(ack.client, MQTTControlMessage::ack(
+            MQTTControlMessage::Type::PUBREL, broker_name, ack.packet_id));
+        return;
+    }
+    
+    session.inflight.erase(it);
+    send_pending(ack.client);
+}
+
+void MQTTBroker::charge(double flops) {
+    if (flops <= 0) {
+        return;
+    }
+    double start = sg4::Engine::get_clock();
+    sg4::this_actor::execute(flops);
+    busy_time += sg4::Engine::get_clock() - start;
+}
+
+bool MQTTBroker::apply_operators(const std::shared_ptr<MQTTMessage>& msg) {
+    double now = sg4::Engine::get_clock();
+    bool consumed = false;
+    std::vector<std::shared_ptr<MQTTMessage>> derived;
+    
+    for (auto& op : operators) {
+        if (!op.matches(msg->topic)) continue;
+        
+        charge(op.get_config().cost_per_message);
+        op.process(msg, now, derived);
+        consumed = consumed || op.get_config().consume;
+    }
+    
+    publish_derived(derived);
+    return consumed;
+}
+
+void MQTTBroker::flush_operators() {
+    double now = sg4::Engine::get_clock();
+    std::vector<std::shared_ptr<MQTTMessage>> derived;
+    
+    for (auto& op : operators) {
+        op.flush(now, derived);
+    }
+    publish_derived(derived);
+}
+
+void MQTTBroker::publish_derived(const std::vector<std::shared_ptr<MQTTMessage>>& derived) {
+    // Derived messages are routed like publishes but not fed to operators
+    // again, so operators cannot feed each other in a loop
+    for (const auto& msg : derived) {
+        messages_published++;
+        traffic_stats->record_publish(msg->topic, msg->size, sg4::Engine::get_clock());
+        route(msg);
+    }
+}
+
+double MQTTBroker::next_operator_deadline() const {
+    double deadline = std::numeric_limits<double>::infinity();
+    for (const auto& op : operators) {
+        deadline = std::min(deadline, op.next_deadline());
+    }
+    return deadline;
+}
+
+void MQTTBroker::start_workers() {
+    sg4::Host* host = sg4::this_actor::get_host();
+    int count = std::min(config.service.workers, host->get_core_count());
+    
+    // A single worker is the broker actor itself
+    if (count <= 1) {
+        return;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        auto queue = std::make_shared<WorkQueue>();
+        queue->mutex = sg4::Mutex::create();
+        queue->cond = sg4::ConditionVariable::create();
+        work_queues.push_back(queue);
+        workers.push_back(host->add_actor(broker_name + "_worker_" + std::to_string(i),
+                                          [this, queue]() { worker_loop(queue); }));
+    }
+    XBT_INFO("Broker '%s' using %d workers", broker_name.c_str(), count);
+}
+
+void MQTTBroker::stop_workers() {
+    for (auto& queue : work_queues) {
+        std::unique_lock<sg4::Mutex> lock(*queue->mutex);
+        queue->closed = true;
+        queue->cond->notify_all();
+    }
+    for (auto& worker : workers) {
+        worker->join();
+    }
+    workers.clear();
+}
+
+void MQTTBroker::dispatch(MQTTControlMessage* ctrl_msg) {
+    std::string key = ctrl_msg->client;
+    if (key.empty() && ctrl_msg->message) {
+        key = ctrl_msg->message->publisher;
+    } else if (key.empty() && !ctrl_msg->batch.empty()) {
+        key = ctrl_msg->batch.front()->publisher;
+    }
+    auto& queue = work_queues[std::hash<std::string>{}(key) % work_queues.size()];
+    
+    std::unique_lock<sg4::Mutex> lock(*queue->mutex);
+    queue->messages.push_back(ctrl_msg);
+    queue->cond->notify_all();
+}
+
+void MQTTBroker::worker_loop(std::shared_ptr<WorkQueue> queue) {
+    std::unique_lock<sg4::Mutex> lock(*queue->mutex);
+    
+    while (true) {
+        while (queue->messages.empty() && !queue->closed) {
+            queue->cond->wait(lock);
+        }
+        if (queue->messages.empty()) {
+            break;  // Closed and drained
+        }
+        
+        MQTTControlMessage* ctrl_msg = queue->messages.front();
+        queue->messages.pop_front();
+        
+        lock.unlock();
+        handle_control(*ctrl_msg);
+        delete ctrl_msg;
+        lock.lock();
+    }
+}
+
+const MQTTBroker::Subscription& MQTTBroker::select_shared(const std::string& filter,
+                                                          const std::vector<Subscription>& members,
+                                                          const MQTTMessage& msg) {
+    std::string group;
+    std::string topic_filter;
+    parse_shared_subscription(filter, group, topic_filter);
+    
+    auto override_it = config.share_overrides.find(group);
+    MQTTShareStrategy strategy = override_it != config.share_overrides.end()
+                                     ? override_it->second
+                                     : config.share_strategy;
+    
+    size_t& cursor = share_cursors[filter];
+    size_t index = 0;
+    
+    switch (strategy) {
+        case MQTTShareStrategy::ROUND_ROBIN:
+            index = cursor % members.size();
+            cursor = index + 1;
+            break;
+            
+        case MQTTShareStrategy::LEAST_QUEUE_DEPTH: {
+            // Ties are broken round-robin so idle members share the load
+            size_t best = std::numeric_limits<size_t>::max();
+            for (size_t i = 0; i < members.size(); i++) {
+                size_t candidate = (cursor + i) % members.size();
+                size_t backlog = subscriber_backlog(members[candidate].subscriber);
+                if (backlog < best) {
+                    best = backlog;
+                    index = candidate;
+                }
+            }
+            cursor = index + 1;
+            break;
+        }
+        
+        case MQTTShareStrategy::HASH_PUBLISHER:
+            index = std::hash<std::string>{}(msg.publisher) % members.size();
+            break;
+    }
+    
+    XBT_DEBUG("Shared subscription '%s' -> '%s'",
+              filter.c_str(), members[index].subscriber.c_str());
+    return members[index];
+}
+
+size_t MQTTBroker::subscriber_backlog(const std::string& subscriber) const {
+    size_t backlog = 0;
+    
+    auto outbox_it = outboxes.find(subscriber);
+    if (outbox_it != outboxes.end()) {
+        backlog += outbox_it->second->queue.size();
+    }
+    
+    auto session_it = sessions.find(subscriber);
+    if (session_it != sessions.end()) {
+        const Session& session = session_it->second;
+        backlog += session.inflight.size() + session.pending.size() + session.stored.size();
+    }
+    return backlog;
+}
+
+void MQTTBroker::deliver(const std::string& subscriber, std::shared_ptr<MQTTMessage> msg,
+                         int qos) {
+    // Offline persistent session: keep the message until the client is back
+    auto session_it = sessions.find(subscriber);
+    if (session_it != sessions.end() && session_it->second.offline) {
+        store_offline(session_it->second, MQTTDelivery(msg, qos));
+        return;
+    }
+    
+    if (qos == 0) {
+        send_delivery(subscriber, MQTTDelivery(msg));
         return;
     }
     
-    // Deliver to all subscribers
-    for (const auto& subscriber : it->second) {
-        auto* mbox = sg4::Mailbox::by_name(subscriber);
+    sessions[subscriber].pending.emplace_back(msg, qos);
+    send_pending(subscriber);
+}
+
+void MQTTBroker::send_pending(const std::string& subscriber) {
+    while (true) {
+        // Looked up again after every send: a full queue blocks this actor,
+        // and the client may be removed or go offline meanwhile
+        auto session_it = sessions.find(subscriber);
+        if (session_it == sessions.end()) {
+            return;
+        }
+        Session& session = session_it->second;
+        if (session.offline || session.pending.empty() ||
+            config.qos.window_full(session.inflight.size())) {
+            return;
+        }
+        
+        MQTTDelivery delivery = session.pending.front();
+        session.pending.pop_front();
         
-        // Create a copy of the message for each subscriber
-        auto* msg_copy = new std::shared_ptr<MQTTMessage>(msg);
+        delivery.packet_id = session.next_packet_id;
+        session.next_packet_id = session.next_packet_id % 65535 + 1;
         
-        XBT_DEBUG("Delivering message to subscriber '%s'", subscriber.c_str());
-        mbox->put(msg_copy, msg->size);
-        messages_delivered++;
+        session.inflight.emplace(delivery.packet_id,
+                                 InFlight{delivery, false, sg4::Engine::get_clock()});
+        send_delivery(subscriber, delivery);
+    }
+}
+
+void MQTTBroker::send_delivery(const std::string& subscriber, const MQTTDelivery& delivery) {
+    auto outbox = get_outbox(subscriber);
+    std::unique_lock<sg4::Mutex> lock(*outbox->mutex);
+    
+    if (outbox->disconnected) {
+        outbox->dropped++;
+        return;
+    }
+    
+    const auto& queue_cfg = outbox->config;
+    if (queue_cfg.capacity > 0 && outbox->queue.size() >= queue_cfg.capacity) {
+        switch (queue_cfg.policy) {
+            case MQTTOverflowPolicy::BLOCK:
+                XBT_DEBUG("Queue of '%s' full, waiting", subscriber.c_str());
+                while (outbox->queue.size() >= queue_cfg.capacity && !outbox->closed) {
+                    outbox->cond->wait(lock);
+                }
+                // Closed or replaced while waiting: nobody drains it any more
+                if (outbox->closed) {
+                    outbox->dropped++;
+                    return;
+                }
+                break;
+                
+            case MQTTOverflowPolicy::DROP_OLDEST:
+                outbox->queue.pop_front();
+                outbox->dropped++;
+                break;
+                
+            case MQTTOverflowPolicy::DROP_NEWEST:
+                outbox->dropped++;
+                return;
+                
+            case MQTTOverflowPolicy::DISCONNECT:
+                XBT_WARN("Subscriber '%s' overflowed its queue (%zu messages), disconnecting",
+                         subscriber.c_str(), queue_cfg.capacity);
+                outbox->dropped += static_cast<int>(outbox->queue.size()) + 1;
+                outbox->queue.clear();
+                outbox->disconnected = true;
+                outbox->closed = true;
+                outbox->cond->notify_all();
+                // Subscriptions are removed once the current message is routed
+                pending_disconnects.push_back(subscriber);
+                return;
+        }
+    }
+    
+    XBT_DEBUG("Queueing message for subscriber '%s' (QoS %d, packet %d)",
+              subscriber.c_str(), delivery.qos, delivery.packet_id);
+    outbox->queue.push_back(delivery);
+    outbox->enqueued++;
+    outbox->max_depth = std::max(outbox->max_depth, outbox->queue.size());
+    outbox->cond->notify_all();
+}
+
+void MQTTBroker::send_to_client(const std::string& client, MQTTControlMessage* msg) {
+    // Acknowledgements never block the broker on a busy client
+    sg4::Mailbox::by_name(get_client_mailbox(client))
+        ->put_init(msg, msg->wire_size())
+        ->detach();
+}
+
+void MQTTBroker::store_retained(std::shared_ptr<MQTTMessage> msg) {
+    auto it = retained.find(msg->topic);
+    if (it != retained.end()) {
+        stored_bytes -= stored_size(*it->second);
+        retained.erase(it);
+    }
+    
+    // An empty retained message clears the topic
+    if (msg->size == 0) {
+        XBT_DEBUG("Retained message of '%s' cleared", msg->topic.c_str());
+        return;
+    }
+    
+    size_t bytes = stored_size(*msg);
+    if (!reserve_storage(bytes)) {
+        storage_rejected++;
+        XBT_DEBUG("No room to retain message on '%s'", msg->topic.c_str());
+        return;
+    }
+    
+    retained[msg->topic] = msg;
+    stored_bytes += bytes;
+    max_stored_bytes = std::max(max_stored_bytes, stored_bytes);
+}
+
+void MQTTBroker::send_retained(const std::string& filter, const std::string& subscriber,
+                               int qos) {
+    // Shared subscriptions do not receive retained messages (MQTT 5)
+    std::string group;
+    std::string topic_filter;
+    if (parse_shared_subscription(filter, group, topic_filter)) {
+        return;
+    }
+    
+    // Collect first: delivering may block and let publishes change the store
+    std::vector<std::shared_ptr<MQTTMessage>> matches;
+    for (const auto& [topic, msg] : retained) {
+        if (topic_matches(filter, topic)) {
+            matches.push_back(msg);
+        }
+    }
+    
+    for (const auto& msg : matches) {
+        deliver(subscriber, msg, std::min(msg->qos, qos));
+    }
+    if (!matches.empty()) {
+        XBT_DEBUG("Sent %zu retained messages to '%s'", matches.size(), subscriber.c_str());
+    }
+}
+
+void MQTTBroker::store_offline(Session& session, const MQTTDelivery& delivery) {
+    size_t bytes = stored_size(*delivery.message);
+    if (!reserve_storage(bytes)) {
+        storage_rejected++;
+        return;
+    }
+    
+    session.stored.push_back(delivery);
+    stored_bytes += bytes;
+    max_stored_bytes = std::max(max_stored_bytes, stored_bytes);
+    messages_stored++;
+}
+
+void MQTTBroker::resume_session(const std::string& client) {
+    Session& session = sessions[client];
+    session.offline = false;
+    
+    std::deque<MQTTDelivery> stored;
+    stored.swap(session.stored);
+    for (const auto& delivery : stored) {
+        stored_bytes -= stored_size(*delivery.message);
+    }
+    messages_replayed += static_cast<int>(stored.size());
+    XBT_INFO("Session of '%s' resumed, replaying %zu stored messages",
+             client.c_str(), stored.size());
+    
+    // Deliveries of the previous connection are retransmitted on the usual
+    // timer, counted from the reconnection
+    double now = sg4::Engine::get_clock();
+    for (auto& [id, entry] : session.inflight) {
+        entry.sent_at = now;
+    }
+    
+    // QoS 0 sends may block, so the session is looked up for each message
+    for (const auto& delivery : stored) {
+        if (delivery.qos == 0) {
+            send_delivery(client, delivery);
+            continue;
+        }
+        auto session_it = sessions.find(client);
+        if (session_it == sessions.end()) {
+            return;  // Removed while blocked
+        }
+        session_it->second.pending.push_back(delivery);
+    }
+    send_pending(client);
+}
+
+bool MQTTBroker::reserve_storage(size_t bytes) {
+    const auto& storage = config.storage;
+    if (storage.memory_budget == 0) {
+        return true;
+    }
+    if (bytes > storage.memory_budget) {
+        return false;
+    }
+    
+    while (stored_bytes + bytes > storage.memory_budget) {
+        if (storage.eviction == MQTTEvictionPolicy::REJECT_NEW || !evict_oldest()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MQTTBroker::evict_oldest() {
+    // Oldest publish time among retained messages and the heads of the
+    // offline queues (each queue is in publish order)
+    double oldest = std::numeric_limits<double>::infinity();
+    Session* oldest_session = nullptr;
+    auto oldest_retained = retained.end();
+    
+    for (auto& [client, session] : sessions) {
+        if (!session.stored.empty() && session.stored.front().message->timestamp < oldest) {
+            oldest = session.stored.front().message->timestamp;
+            oldest_session = &session;
+        }
+    }
+    for (auto it = retained.begin(); it != retained.end(); ++it) {
+        if (it->second->timestamp < oldest) {
+            oldest = it->second->timestamp;
+            oldest_session = nullptr;
+            oldest_retained = it;
+        }
+    }
+    
+    if (oldest_session) {
+        stored_bytes -= stored_size(*oldest_session->stored.front().message);
+        oldest_session->stored.pop_front();
+    } else if (oldest_retained != retained.end()) {
+        stored_bytes -= stored_size(*oldest_retained->second);
+        retained.erase(oldest_retained);
+    } else {
+        return false;  // Nothing left to evict
+    }
+    
+    storage_evictions++;
+    return true;
+}
+
+void MQTTBroker::remove_client(const std::string& client) {
+    for (auto it = subscriptions.begin(); it != subscriptions.end();) {
+        auto& subs = it->second;
+        subs.erase(std::remove_if(subs.begin(), subs.end(),
+                                  [&](const Subscription& s) { return s.subscriber == client; }),
+                   subs.end());
+        if (subs.empty()) {
+            erase_filter(it++);
+        } else {
+            ++it;
+        }
+    }
+    
+    auto session_it = sessions.find(client);
+    if (session_it != sessions.end()) {
+        for (const auto& delivery : session_it->second.stored) {
+            stored_bytes -= stored_size(*delivery.message);
+        }
+        sessions.erase(session_it);
+    }
+}
+
+size_t MQTTBroker::stored_size(const MQTTMessage& msg) {
+    return msg.topic.size() + msg.size;
+}
+
+std::shared_ptr<MQTTBroker::Outbox> MQTTBroker::get_outbox(const std::string& subscriber) {
+    auto it = outboxes.find(subscriber);
+    if (it != outboxes.end()) {
+        return it->second;
+    }
+    return open_outbox(subscriber);
+}
+
+std::shared_ptr<MQTTBroker::Outbox> MQTTBroker::open_outbox(const std::string& subscriber) {
+    auto outbox = std::make_shared<Outbox>();
+    outbox->subscriber = subscriber;
+    outbox->mutex = sg4::Mutex::create();
+    outbox->cond = sg4::ConditionVariable::create();
+    outbox->stats = traffic_stats;
+    
+    auto override_it = config.queue_overrides.find(subscriber);
+    outbox->config = override_it != config.queue_overrides.end() ? override_it->second
+                                                                  : config.queue;
+    
+    // Keep the counters of a previous connection
+    auto& slot = outboxes[subscriber];
+    if (slot) {
+        outbox->enqueued = slot->enqueued;
+        outbox->delivered = slot->delivered;
+        outbox->dropped = slot->dropped;
+        outbox->max_depth = slot->max_depth;
     }
+    slot = outbox;
+    
+    sg4::this_actor::get_host()
+        ->add_actor("mqtt_egress_" + subscriber, [outbox]() { egress_loop(outbox); })
+        ->daemonize();
     
-    XBT_INFO("Message delivered to %zu subscribers", it->second.size());
+    return outbox;
+}
+
+void MQTTBroker::egress_loop(std::shared_ptr<Outbox> outbox) {
+    auto* mbox = sg4::Mailbox::by_name(outbox->subscriber);
+    std::unique_lock<sg4::Mutex> lock(*outbox->mutex);
+    
+    while (true) {
+        while (outbox->queue.empty() && !outbox->closed) {
+            outbox->cond->wait(lock);
+        }
+        if (outbox->queue.empty()) {
+            break;  // Closed and drained
+        }
+        
+        MQTTDelivery delivery = outbox->queue.front();
+        outbox->queue.pop_front();
+        outbox->cond->notify_all();  // Room for a blocked broker
+        
+        lock.unlock();
+        mbox->put(new MQTTDelivery(delivery), delivery.wire_size());
+        lock.lock();
+        
+        outbox->delivered++;
+        outbox->stats->record_delivery(outbox->subscriber, delivery.message->topic,
+                                       sg4::Engine::get_clock() - delivery.message->timestamp);
+    }
+}
+
+void MQTTBroker::process_disconnects() {
+    for (const auto& subscriber : pending_disconnects) {
+        remove_client(subscriber);
+        subscribers_disconnected++;
+    }
+    pending_disconnects.clear();
+}
+
+void MQTTBroker::close_outboxes() {
+    for (auto& [subscriber, outbox] : outboxes) {
+        std::unique_lock<sg4::Mutex> lock(*outbox->mutex);
+        outbox->closed = true;
+        outbox->cond->notify_all();
+    }
+}
+
+void MQTTBroker::sample_queue_depth() {
+    double now = sg4::Engine::get_clock();
+    if (now < last_depth_sample + config.stats.sample_interval) {
+        return;
+    }
+    last_depth_sample = now;
+    
+    MQTTDepthSample sample{now, 0, 0, 0, stored_bytes};
+    for (const auto& [subscriber, outbox] : outboxes) {
+        sample.total_depth += outbox->queue.size();
+        sample.max_depth = std::max(sample.max_depth, outbox->queue.size());
+    }
+    for (const auto& [subscriber, session] : sessions) {
+        sample.inflight += session.inflight.size();
+    }
+    traffic_stats->record_depth(sample);
+}
+
+void MQTTBroker::export_stats() const {
+    double now = sg4::Engine::get_clock();
+    const std::string& prefix = config.stats.export_prefix;
+    
+    try {
+        traffic_stats->export_csv(prefix, now);
+        traffic_stats->export_json(prefix + ".json", now);
+    } catch (const std::exception& ex) {
+        XBT_WARN("Could not export statistics of broker '%s': %s",
+                 broker_name.c_str(), ex.what());
+    }
+}
+
+double MQTTBroker::next_retransmit_deadline() const {
+    double deadline = std::numeric_limits<double>::infinity();
+    for (const auto& [subscriber, session] : sessions) {
+        if (session.offline) continue;
+        for (const auto& [id, entry] : session.inflight) {
+            deadline = std::min(deadline, entry.sent_at + config.qos.retransmit_timeout);
+        }
+    }
+    return deadline;
+}
+
+void MQTTBroker::retransmit_expired() {
+    double now = sg4::Engine::get_clock();
+    
+    // Deliveries are sent after the scan: a send may block, and the
+    // sessions must not be iterated across it
+    std::vector<std::pair<std::string, MQTTDelivery>> resend;
+    
+    for (auto& [subscriber, session] : sessions) {
+        if (session.offline) continue;  // Resent once the client is back
+        for (auto& [id, entry] : session.inflight) {
+            if (entry.sent_at + config.qos.retransmit_timeout > now) continue;
+            
+            retransmissions++;
+            entry.sent_at = now;
+            
+            if (entry.released) {
+                XBT_DEBUG("Retransmitting PUBREL %d to '%s'", id, subscriber.c_str());
+                send_to_client(subscriber, MQTTControlMessage::ack(
+                    MQTTControlMessage::Type::PUBREL, broker_name, id));
+            } else {
+                XBT_DEBUG("Retransmitting packet %d to '%s'", id, subscriber.c_str());
+                entry.delivery.dup = true;
+                resend.emplace_back(subscriber, entry.delivery);
+            }
+        }
+    }
+    
+    for (const auto& [subscriber, delivery] : resend) {
+        send_delivery(subscriber, delivery);
+    }
+}
+
+bool MQTTBroker::topic_matches(const std::string& filter, const std::string& topic) {
+    std::string_view f = filter;
+    std::string_view t = topic;
+    
+    // A shared subscription matches like its topic filter
+    constexpr std::string_view share_prefix = "$share/";
+    if (f.substr(0, share_prefix.size()) == share_prefix) {
+        size_t group_end = f.find('/', share_prefix.size());
+        if (group_end != std::string_view::npos && group_end != share_prefix.size()) {
+            f.remove_prefix(group_end + 1);
+        }
+    }
+    
+    // One level per iteration; an empty level (e.g. the last one of "a/")
+    // is a level like any other
+    while (true) {
+        size_t f_end = f.find('/');
+        std::string_view level = f.substr(0, f_end);
+        
+        // Multi-level wildcard matches the parent level and everything below
+        if (level == "#") {
+            return true;
+        }
+        
+        size_t t_end = t.find('/');
+        if (level != "+" && level != t.substr(0, t_end)) {
+            return false;
+        }
+        
+        if (f_end == std::string_view::npos) {
+            return t_end == std::string_view::npos;
+        }
+        if (t_end == std::string_view::npos) {
+            std::string_view next = f.substr(f_end + 1);
+            return next.substr(0, next.find('/')) == "#";  // "a/#" matches "a"
+        }
+        f.remove_prefix(f_end + 1);
+        t.remove_prefix(t_end + 1);
+    }
+}
+
+bool MQTTBroker::is_pattern(const std::string& filter) {
+    return filter.find_first_of("+#") != std::string::npos ||
+           filter.compare(0, 7, "$share/") == 0;
+}
+
+void MQTTBroker::erase_filter(std::map<std::string, std::vector<Subscription>>::iterator it) {
+    pattern_filters.erase(it->first);
+    subscriptions.erase(it);
+}
+
+bool MQTTBroker::parse_shared_subscription(const std::string& filter,
+                                           std::string& group,
+                                           std::string& topic_filter) {
+    static const std::string prefix = "$share/";
+    if (filter.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    
+    size_t group_end = filter.find('/', prefix.size());
+    if (group_end == std::string::npos || group_end == prefix.size()) {
+        return false;  // Missing group name or topic filter
+    }
+    
+    group = filter.substr(prefix.size(), group_end - prefix.size());
+    topic_filter = filter.substr(group_end + 1);
+    return true;
 }
 
 std::string MQTTBroker::get_broker_mailbox(const std::string& broker_name) {
@@ -123,15 +1185,131 @@ std::string MQTTBroker::get_topic_mailbox(const std::string& broker_name,
     return "mqtt_" + broker_name + "_topic_" + topic;
 }
 
+std::string MQTTBroker::get_client_mailbox(const std::string& client_id) {
+    return client_id + "_ctrl";
+}
+
 void MQTTBroker::print_stats() const {
     XBT_INFO("=== MQTT Broker Statistics ===");
+    int delivered = 0;
+    int dropped = 0;
+    for (const auto& [subscriber, outbox] : outboxes) {
+        delivered += outbox->delivered;
+        dropped += outbox->dropped;
+    }
+    
+    XBT_INFO("  Connections: %d (%zu clients, %d keepalive pings)",
+             connects, connected_clients.size(), pings);
     XBT_INFO("  Messages published: %d", messages_published);
-    XBT_INFO("  Messages delivered: %d", messages_delivered);
+    XBT_INFO("  Messages delivered: %d", delivered);
+    XBT_INFO("  Messages dropped (queue overflow): %d", dropped);
+    XBT_INFO("  Subscribers disconnected: %d", subscribers_disconnected);
+    XBT_INFO("  QoS retransmissions: %d", retransmissions);
+    XBT_INFO("  QoS 2 duplicates suppressed: %d", duplicates_suppressed);
+    
+    if (messages_rate_rejected > 0 || messages_rate_delayed > 0) {
+        XBT_INFO("  Rate limited: %d rejected, %d delayed (%.6f s total delay)",
+                 messages_rate_rejected, messages_rate_delayed, rate_delay);
+        size_t still_held = 0;
+        for (const auto& [publisher, queue] : held) {
+            still_held += queue.size();
+        }
+        if (still_held > 0) {
+            XBT_INFO("    %zu delayed messages not released before shutdown", still_held);
+        }
+        for (const auto& [publisher, count] : throttled_publishers) {
+            XBT_INFO("    '%s': %d throttled", publisher.c_str(), count);
+        }
+    }
+    
+    size_t offline = std::count_if(sessions.begin(), sessions.end(),
+                                   [](const auto& entry) { return entry.second.offline; });
+    XBT_INFO("  Retained messages: %zu", retained.size());
+    XBT_INFO("  Offline sessions: %zu (%d messages stored, %d replayed)",
+             offline, messages_stored, messages_replayed);
+    XBT_INFO("  Stored bytes: %zu (max %zu / budget %zu), %d evicted, %d rejected",
+             stored_bytes, max_stored_bytes, config.storage.memory_budget,
+             storage_evictions, storage_rejected);
+    
+    double elapsed = sg4::Engine::get_clock();
+    int worker_count = std::max<int>(1, static_cast<int>(work_queues.size()));
+    if (busy_time > 0 && elapsed > 0) {
+        XBT_INFO("  CPU busy time: %.6f s (utilization %.1f%% of %d worker(s))",
+                 busy_time, 100.0 * busy_time / (elapsed * worker_count), worker_count);
+    }
+    if (!operators.empty()) {
+        XBT_INFO("  Stream operators: %zu", operators.size());
+        for (const auto& op : operators) {
+            op.print();
+        }
+    }
+    
     XBT_INFO("  Active topics: %zu", subscriptions.size());
     
     for (const auto& [topic, subs] : subscriptions) {
         XBT_INFO("    Topic '%s': %zu subscribers", topic.c_str(), subs.size());
     }
+    
+    for (const auto& [filter, counts] : share_deliveries) {
+        std::string summary;
+        for (const auto& [member, count] : counts) {
+            summary += (summary.empty() ? "" : ", ") + member + "=" + std::to_string(count);
+        }
+        XBT_INFO("    Shared '%s': %s", filter.c_str(), summary.c_str());
+    }
+    
+    XBT_INFO("  Subscriber queues: %zu", outboxes.size());
+    for (const auto& [subscriber, outbox] : outboxes) {
+        XBT_INFO("    '%s': delivered %d, dropped %d, depth %zu (max %zu / %zu)",
+                 subscriber.c_str(), outbox->delivered, outbox->dropped,
+                 outbox->queue.size(), outbox->max_depth, outbox->config.capacity);
+    }
+    
+    traffic_stats->print(sg4::Engine::get_clock());
+}
+
+size_t MQTTControlMessage::wire_size() const {
+    switch (type) {
+        case Type::CONNECT:
+            return MQTTWire::connect(client.size());
+            
+        case Type::CONNACK:
+            return MQTTWire::connack();
+            
+        case Type::SUBSCRIBE:
+            return MQTTWire::subscribe(topic.size());
+            
+        case Type::UNSUBSCRIBE:
+            return MQTTWire::unsubscribe(topic.size());
+            
+        case Type::PUBLISH:
+            return MQTTWire::publish(message->topic.size(), message->size, packet_id != 0,
+                                     message->properties);
+            
+        case Type::PUBLISH_BATCH: {
+            // Back-to-back PUBLISH packets in one transfer
+            size_t total = 0;
+            for (size_t i = 0; i < batch.size(); i++) {
+                bool has_packet_id = i < packet_ids.size() && packet_ids[i] != 0;
+                total += MQTTWire::publish(batch[i]->topic.size(), batch[i]->size,
+                                           has_packet_id, batch[i]->properties);
+            }
+            return total;
+        }
+        
+        case Type::PUBACK:
+        case Type::PUBREC:
+        case Type::PUBREL:
+        case Type::PUBCOMP:
+            return MQTTWire::ack();
+            
+        case Type::PINGREQ:
+        case Type::PINGRESP:
+        case Type::DISCONNECT:
+        case Type::SHUTDOWN:
+            return MQTTWire::empty();
+    }
+    return MQTTWire::empty();
 }
 
 } // namespace mqtt
@@ -0,0 +1,39 @@
+#include "comms/mqtt/MQTTCompression.hpp"
+#include "comms/mqtt/MQTTBroker.hpp"
+#include <simgrid/s4u.hpp>
+
+XBT_LOG_NEW_DEFAULT_CATEGORY(mqtt_compression, "MQTT Compression");
+
+namespace enigma {
+namespace mqtt {
+
+namespace sg4 = simgrid::s4u;
+
+bool compress_message(const MQTTCodec& codec, size_t min_size, MQTTMessage& msg,
+                      MQTTCompressionStats& stats) {
+    if (!codec.enabled() || !msg.codec.empty() || msg.size < min_size) {
+        return false;
+    }
+    
+    double start = sg4::Engine::get_clock();
+    if (codec.compress_cost > 0) {
+        sg4::this_actor::execute(codec.compress_cost * static_cast<double>(msg.size));
+    }
+    
+    msg.codec = codec.name;
+    msg.uncompressed_size = msg.size;
+    msg.decompress_cost = codec.decompress_cost * static_cast<double>(msg.size);
+    msg.size = codec.compressed_size(msg.size);
+    
+    stats.messages_compressed++;
+    stats.payload_bytes_in += msg.uncompressed_size;
+    stats.payload_bytes_out += msg.size;
+    stats.compression_time += sg4::Engine::get_clock() - start;
+    
+    XBT_DEBUG("Compressed payload on '%s' with %s: %zu -> %zu bytes",
+              msg.topic.c_str(), msg.codec.c_str(), msg.uncompressed_size, msg.size);
+    return true;
+}
+
+} // namespace mqtt
+} // namespace enigma
@@ -0,0 +1,74 @@
+#include "comms/mqtt/MQTTDispatcher.hpp"
+#include <simgrid/s4u.hpp>
+#include <limits>
+
+XBT_LOG_NEW_DEFAULT_CATEGORY(mqtt_dispatcher, "MQTT Dispatcher");
+
+namespace enigma {
+namespace mqtt {
+
+namespace sg4 = simgrid::s4u;
+
+MQTTDispatcher::MQTTDispatcher()
+    : running(false), messages_decompressed(0), decompression_time(0) {}
+
+void MQTTDispatcher::on_message(const std::string& topic_filter, MQTTMessageHandler handler) {
+    handlers.emplace_back(topic_filter, std::move(handler));
+}
+
+size_t MQTTDispatcher::run(const BatchReceiver& receive_batch, double idle_timeout,
+                           size_t max_messages) {
+    size_t dispatched = 0;
+    running = true;
+    
+    while (running && (max_messages == 0 || dispatched < max_messages)) {
+        size_t room = max_messages == 0 ? std::numeric_limits<size_t>::max()
+                                        : max_messages - dispatched;
+        auto batch = receive_batch(room, idle_timeout);
+        
+        if (batch.empty()) {
+            XBT_DEBUG("No message within %.2f s, leaving dispatch loop", idle_timeout);
+            break;
+        }
+        
+        // Messages already taken from the mailbox are always dispatched,
+        // even if a handler calls stop()
+        for (const auto& msg : batch) {
+            dispatch(msg);
+            dispatched++;
+        }
+    }
+    
+    running = false;
+    return dispatched;
+}
+
+void MQTTDispatcher::dispatch(const std::shared_ptr<MQTTMessage>& msg) {
+    bool handled = false;
+    for (const auto& [filter, handler] : handlers) {
+        if (MQTTBroker::topic_matches(filter, msg->topic)) {
+            handler(msg);
+            handled = true;
+        }
+    }
+    
+    if (!handled) {
+        XBT_DEBUG("No handler for message on topic '%s'", msg->topic.c_str());
+    }
+}
+
+void MQTTDispatcher::decompress(const MQTTMessage& msg) {
+    if (msg.codec.empty()) {
+        return;
+    }
+    
+    double start = sg4::Engine::get_clock();
+    if (msg.decompress_cost > 0) {
+        sg4::this_actor::execute(msg.decompress_cost);
+    }
+    messages_decompressed++;
+    decompression_time += sg4::Engine::get_clock() - start;
+}
+
+} // namespace mqtt
+} // namespace enigma
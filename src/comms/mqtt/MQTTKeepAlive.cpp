@@ -0,0 +1,56 @@
+#include "comms/mqtt/MQTTKeepAlive.hpp"
+#include "comms/mqtt/MQTTBroker.hpp"
+
+XBT_LOG_NEW_DEFAULT_CATEGORY(mqtt_keepalive, "MQTT Keepalive");
+
+namespace enigma {
+namespace mqtt {
+
+namespace sg4 = simgrid::s4u;
+
+void MQTTKeepAlive::start(const std::string& client_id, sg4::Mailbox* broker_mbox,
+                          double interval) {
+    if (interval <= 0) {
+        state.reset();
+        return;
+    }
+    
+    state = std::make_shared<State>();
+    state->client_id = client_id;
+    state->broker_mbox = broker_mbox;
+    state->interval = interval;
+    state->last_activity = sg4::Engine::get_clock();
+    
+    std::weak_ptr<State> weak_state = state;
+    sg4::this_actor::get_host()
+        ->add_actor(client_id + "_keepalive", [weak_state]() { ping_loop(weak_state); })
+        ->daemonize();
+    
+    XBT_DEBUG("Keepalive of '%s' every %.2f s", client_id.c_str(), interval);
+}
+
+void MQTTKeepAlive::ping_loop(std::weak_ptr<State> weak_state) {
+    while (true) {
+        double wait;
+        {
+            auto s = weak_state.lock();
+            if (!s) {
+                break;  // Client destroyed
+            }
+            
+            double now = sg4::Engine::get_clock();
+            wait = s->last_activity + s->interval - now;
+            if (wait <= 0) {
+                auto* ping = MQTTControlMessage::ping(s->client_id);
+                s->broker_mbox->put_init(ping, ping->wire_size())->detach();
+                s->last_activity = now;
+                s->pings_sent++;
+                wait = s->interval;
+            }
+        }
+        sg4::this_actor::sleep_for(wait);
+    }
+}
+
+} // namespace mqtt
+} // namespace enigma
@@ -0,0 +1,182 @@
+#include "comms/mqtt/MQTTOperator.hpp"
+#include "comms/mqtt/MQTTBroker.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+
+XBT_LOG_NEW_DEFAULT_CATEGORY(mqtt_operator, "MQTT Stream Operators");
+
+namespace enigma {
+namespace mqtt {
+
+namespace {
+
+// Numeric value at the start of a payload
+bool parse_value(const std::string& payload, double& value) {
+    const char* begin = payload.c_str();
+    char* end = nullptr;
+    value = std::strtod(begin, &end);
+    return end != begin;
+}
+
+size_t wire_bytes(const MQTTMessage& msg) {
+    return MQTTWire::publish(msg.topic.size(), msg.size, msg.qos > 0, msg.properties);
+}
+
+const char* type_name(MQTTOperatorType type) {
+    switch (type) {
+        case MQTTOperatorType::COUNT:      return "count";
+        case MQTTOperatorType::MEAN:       return "mean";
+        case MQTTOperatorType::MIN:        return "min";
+        case MQTTOperatorType::MAX:        return "max";
+        case MQTTOperatorType::DEADBAND:   return "deadband";
+        case MQTTOperatorType::DOWNSAMPLE: return "downsample";
+    }
+    return "unknown";
+}
+
+} // namespace
+
+MQTTStreamOperator::MQTTStreamOperator(const MQTTOperatorConfig& cfg) : config(cfg) {
+    if (config.name.empty()) {
+        config.name = type_name(config.type);
+    }
+    if (config.output_prefix.empty()) {
+        config.output_prefix = config.name + "/";
+    }
+    if (is_windowed() && config.window <= 0) {
+        throw std::invalid_argument("Operator '" + config.name + "' needs a window > 0");
+    }
+}
+
+bool MQTTStreamOperator::matches(const std::string& topic) const {
+    return MQTTBroker::topic_matches(config.filter, topic);
+}
+
+void MQTTStreamOperator::process(const std::shared_ptr<MQTTMessage>& msg, double now,
+                                 std::vector<std::shared_ptr<MQTTMessage>>& out) {
+    stats.messages_in++;
+    stats.bytes_in += wire_bytes(*msg);
+    
+    if (config.type == MQTTOperatorType::DOWNSAMPLE) {
+        auto it = last_forward.find(msg->topic);
+        if (it == last_forward.end() || now - it->second >= config.window) {
+            last_forward[msg->topic] = now;
+            forward(msg, out);
+        }
+        return;
+    }
+    
+    double value = 0;
+    if (config.type != MQTTOperatorType::COUNT && !parse_value(msg->payload, value)) {
+        stats.unparsable++;
+        XBT_DEBUG("Operator '%s': no value in message on '%s'",
+                  config.name.c_str(), msg->topic.c_str());
+        return;
+    }
+    
+    if (config.type == MQTTOperatorType::DEADBAND) {
+        auto it = last_value.find(msg->topic);
+        if (it == last_value.end() || std::fabs(value - it->second) >= config.deadband) {
+            last_value[msg->topic] = value;
+            forward(msg, out);
+        }
+        return;
+    }
+    
+    // Close the previous window of this topic before opening the next one
+    auto it = windows.find(msg->topic);
+    if (it != windows.end() && now >= it->second.end) {
+        emit(it->first, it->second, out);
+        windows.erase(it);
+        it = windows.end();
+    }
+    if (it == windows.end()) {
+        double end = (std::floor(now / config.window) + 1) * config.window;
+        it = windows.emplace(msg->topic, Window{end, 0, 0, value, value}).first;
+    }
+    
+    Window& window = it->second;
+    window.count++;
+    window.sum += value;
+    window.min = std::min(window.min, value);
+    window.max = std::max(window.max, value);
+}
+
+void MQTTStreamOperator::flush(double now, std::vector<std::shared_ptr<MQTTMessage>>& out) {
+    for (auto it = windows.begin(); it != windows.end();) {
+        if (it->second.end <= now) {
+            emit(it->first, it->second, out);
+            it = windows.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+double MQTTStreamOperator::next_deadline() const {
+    double deadline = std::numeric_limits<double>::infinity();
+    for (const auto& [topic, window] : windows) {
+        deadline = std::min(deadline, window.end);
+    }
+    return deadline;
+}
+
+bool MQTTStreamOperator::is_windowed() const {
+    return config.type == MQTTOperatorType::COUNT || config.type == MQTTOperatorType::MEAN ||
+           config.type == MQTTOperatorType::MIN || config.type == MQTTOperatorType::MAX;
+}
+
+std::string MQTTStreamOperator::derived_topic(const std::string& topic) const {
+    return config.output_prefix + topic;
+}
+
+void MQTTStreamOperator::emit(const std::string& topic, const Window& window,
+                              std::vector<std::shared_ptr<MQTTMessage>>& out) {
+    double value = 0;
+    switch (config.type) {
+        case MQTTOperatorType::COUNT: value = static_cast<double>(window.count); break;
+        case MQTTOperatorType::MEAN:  value = window.sum / window.count; break;
+        case MQTTOperatorType::MIN:   value = window.min; break;
+        case MQTTOperatorType::MAX:   value = window.max; break;
+        default: break;
+    }
+    
+    std::string payload = std::to_string(value);
+    add_output(std::make_shared<MQTTMessage>(derived_topic(topic), payload, payload.size(),
+                                             config.name),
+               out);
+}
+
+void MQTTStreamOperator::forward(const std::shared_ptr<MQTTMessage>& msg,
+                                 std::vector<std::shared_ptr<MQTTMessage>>& out) {
+    // Same payload and timestamp, so latency stays end-to-end
+    auto copy = std::make_shared<MQTTMessage>(*msg);
+    copy->topic = derived_topic(msg->topic);
+    copy->retain = false;
+    add_output(copy, out);
+}
+
+void MQTTStreamOperator::add_output(std::shared_ptr<MQTTMessage> msg,
+                                    std::vector<std::shared_ptr<MQTTMessage>>& out) {
+    stats.messages_out++;
+    stats.bytes_out += wire_bytes(*msg);
+    out.push_back(std::move(msg));
+}
+
+void MQTTStreamOperator::print() const {
+    double saved = stats.bytes_in > 0
+                       ? 100.0 * (1.0 - static_cast<double>(stats.bytes_out) / stats.bytes_in)
+                       : 0.0;
+    XBT_INFO("    '%s' (%s on '%s'): in %d msgs / %zu B, out %d msgs / %zu B (%.1f%% saved)",
+             config.name.c_str(), type_name(config.type), config.filter.c_str(),
+             stats.messages_in, stats.bytes_in, stats.messages_out, stats.bytes_out, saved);
+    if (stats.unparsable > 0) {
+        XBT_INFO("      %d messages without a numeric value", stats.unparsable);
+    }
+}
+
+} // namespace mqtt
+} // namespace enigma
@@ -1,4 +1,7 @@
 #include "comms/mqtt/MQTTPublisher.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 
 XBT_LOG_NEW_DEFAULT_CATEGORY(mqtt_publisher, "MQTT Publisher");
 
@@ -7,8 +10,10 @@ namespace mqtt {
 
 namespace sg4 = simgrid::s4u;
 
-MQTTPublisher::MQTTPublisher(const std::string& broker, const std::string& pub_id)
-    : broker_name(broker) {
+MQTTPublisher::MQTTPublisher(const std::string& broker, const std::string& pub_id,
+                             double connect_timeout)
+    : broker_name(broker), next_packet_id(1), connect_timeout(connect_timeout),
+      compress_min_size(0) {
     
     // Generate publisher ID if not provided
     if (pub_id.empty()) {
@@ -21,32 +26,265 @@ MQTTPublisher::MQTTPublisher(const std::string& broker, const std::string& pub_i
     
     broker_mbox = sg4::Mailbox::by_name(MQTTBroker::get_broker_mailbox(broker_name));
     
+    // Acknowledgements are transferred as soon as the broker sends them,
+    // even while this publisher is busy elsewhere
+    ack_mbox = sg4::Mailbox::by_name(MQTTBroker::get_client_mailbox(publisher_id));
+    ack_mbox->set_receiver(sg4::Actor::self());
+    
+    connect();
+    
     XBT_DEBUG("MQTT Publisher '%s' initialized (broker: %s)",
               publisher_id.c_str(), broker_name.c_str());
 }
 
+void MQTTPublisher::connect() {
+    auto* ctrl_msg = MQTTControlMessage::connect(publisher_id);
+    size_t size = ctrl_msg->wire_size();
+    
+    if (connect_timeout < 0) {
+        send_control(ctrl_msg);
+        
+        // Nothing else can be addressed to us before the CONNACK
+        delete ack_mbox->get<MQTTControlMessage>();
+        return;
+    }
+    
+    double deadline = sg4::Engine::get_clock() + connect_timeout;
+    try {
+        broker_mbox->put(ctrl_msg, size, connect_timeout);
+    } catch (const simgrid::TimeoutException&) {
+        delete ctrl_msg;  // Never taken by the broker
+        throw std::runtime_error("MQTT publisher '" + publisher_id + "': broker '" +
+                                 broker_name + "' did not accept the connection");
+    }
+    stats.bytes_sent += size;
+    keepalive.touch();
+    
+    try {
+        double remaining = deadline - sg4::Engine::get_clock();
+        delete ack_mbox->get<MQTTControlMessage>(std::max(remaining, 1e-6));
+    } catch (const simgrid::TimeoutException&) {
+        throw std::runtime_error("MQTT publisher '" + publisher_id + "': no CONNACK from broker '" +
+                                 broker_name + "' within the connect timeout");
+    }
+}
+
 void MQTTPublisher::publish(const std::string& topic,
                             const std::string& payload,
                             size_t size,
-                            int qos) {
+                            int qos,
+                            bool retain) {
     // Create MQTT message
-    auto msg = std::make_shared<MQTTMessage>(topic, payload, size, publisher_id, qos);
-    
-    // Send to broker
-    auto* ctrl_msg = MQTTControlMessage::publish(msg);
+    auto msg = make_message(topic, payload, size, qos);
+    msg->retain = retain;
+    compress_message(codec, compress_min_size, *msg, stats);
     
     XBT_DEBUG("Publishing to topic '%s' (size: %zu bytes, QoS: %d)",
               topic.c_str(), size, qos);
     
-    broker_mbox->put(ctrl_msg, sizeof(MQTTControlMessage));
+    if (qos <= 0) {
+        send(msg, 0, false);
+        stats.messages_sent++;
+        
+        // Keepalive PINGRESPs pile up in the mailbox otherwise
+        process_acks(0);
+        return;
+    }
+    
+    // Block while the in-flight window is full
+    while (qos_config.window_full(inflight.size())) {
+        process_acks(-1);
+    }
+    
+    int packet_id = next_packet_id;
+    next_packet_id = next_packet_id % 65535 + 1;
+    
+    double now = sg4::Engine::get_clock();
+    inflight.emplace(packet_id, InFlight{msg, false, now, now});
+    send(msg, packet_id, false);
+    stats.messages_sent++;
+    
+    // Collect acknowledgements that already arrived
+    process_acks(0);
 }
 
 void MQTTPublisher::publish(const std::string& topic,
                             const std::string& payload,
-                            int qos) {
+                            int qos,
+                            bool retain) {
     // Automatic size calculation
     size_t size = payload.size();
-    publish(topic, payload, size, qos);
+    publish(topic, payload, size, qos, retain);
+}
+
+void MQTTPublisher::publish_batch(const std::vector<std::shared_ptr<MQTTMessage>>& messages) {
+    if (messages.empty()) {
+        return;
+    }
+    
+    size_t acked = std::count_if(messages.begin(), messages.end(),
+                                 [](const auto& m) { return m->qos > 0; });
+    
+    // Wait for room for the whole batch (an oversized batch goes out once
+    // nothing else is in flight)
+    while (acked > 0 && !inflight.empty() &&
+           qos_config.window_full(inflight.size() + acked - 1)) {
+        process_acks(-1);
+    }
+    
+    for (const auto& msg : messages) {
+        compress_message(codec, compress_min_size, *msg, stats);
+    }
+    
+    double now = sg4::Engine::get_clock();
+    std::vector<int> packet_ids;
+    size_t total_size = 0;
+    
+    for (const auto& msg : messages) {
+        int packet_id = 0;
+        if (msg->qos > 0) {
+            packet_id = next_packet_id;
+            next_packet_id = next_packet_id % 65535 + 1;
+            inflight.emplace(packet_id, InFlight{msg, false, now, now});
+        }
+        packet_ids.push_back(packet_id);
+        total_size += msg->size;
+    }
+    
+    XBT_DEBUG("Publishing batch of %zu messages (%zu bytes)", messages.size(), total_size);
+    
+    send_control(MQTTControlMessage::publish_batch(messages, publisher_id,
+                                                   std::move(packet_ids)));
+    stats.messages_sent += static_cast<int>(messages.size());
+    stats.transfers++;
+    
+    process_acks(0);
+}
+
+std::shared_ptr<MQTTMessage> MQTTPublisher::make_message(const std::string& topic,
+                                                         const std::string& payload,
+                                                         size_t size,
+                                                         int qos) const {
+    return std::make_shared<MQTTMessage>(topic, payload, size, publisher_id, qos);
+}
+
+bool MQTTPublisher::wait_for_acks(double timeout) {
+    double deadline = timeout >= 0 ? sg4::Engine::get_clock() + timeout
+                                   : std::numeric_limits<double>::infinity();
+    
+    while (!inflight.empty()) {
+        double now = sg4::Engine::get_clock();
+        if (now >= deadline) {
+            break;
+        }
+        process_acks(timeout >= 0 ? deadline - now : -1);
+    }
+    
+    return inflight.empty();
+}
+
+void MQTTPublisher::send(const std::shared_ptr<MQTTMessage>& msg, int packet_id, bool dup) {
+    send_control(MQTTControlMessage::publish(msg, publisher_id, packet_id, dup));
+    stats.transfers++;
+}
+
+void MQTTPublisher::send_control(MQTTControlMessage* msg) {
+    size_t size = msg->wire_size();
+    broker_mbox->put(msg, size);
+    stats.bytes_sent += size;
+    keepalive.touch();
+}
+
+bool MQTTPublisher::process_acks(double timeout) {
+    bool received = false;
+    
+    // Drain acknowledgements that are already there
+    while (ack_mbox->ready()) {
+        auto* ack = ack_mbox->get<MQTTControlMessage>();
+        handle_ack(*ack);
+        delete ack;
+        received = true;
+    }
+    
+    // Otherwise wait, but never past the next retransmission
+    if (!received && timeout != 0 && !inflight.empty()) {
+        double wait = next_retransmit_deadline() - sg4::Engine::get_clock();
+        if (timeout > 0) {
+            wait = std::min(wait, timeout);
+        }
+        
+        try {
+            auto* ack = ack_mbox->get<MQTTControlMessage>(std::max(wait, 1e-6));
+            handle_ack(*ack);
+            delete ack;
+            received = true;
+        } catch (const simgrid::TimeoutException&) {
+            XBT_DEBUG("No acknowledgement within %.3f s", wait);
+        }
+    }
+    
+    retransmit_expired();
+    return received;
+}
+
+void MQTTPublisher::handle_ack(const MQTTControlMessage& ack) {
+    if (ack.type == MQTTControlMessage::Type::PINGRESP) {
+        return;
+    }
+    
+    auto it = inflight.find(ack.packet_id);
+    if (it == inflight.end()) {
+        XBT_DEBUG("Stale acknowledgement for packet %d", ack.packet_id);
+        return;
+    }
+    
+    double now = sg4::Engine::get_clock();
+    
+    if (ack.type == MQTTControlMessage::Type::PUBREC) {
+        // QoS 2: release the message and wait for PUBCOMP
+        it->second.released = true;
+        it->second.sent_at = now;
+        send_control(MQTTControlMessage::ack(MQTTControlMessage::Type::PUBREL,
+                                             publisher_id, ack.packet_id));
+        return;
+    }
+    
+    // PUBACK (QoS 1) or PUBCOMP (QoS 2) completes the flow
+    double latency = now - it->second.first_sent;
+    stats.messages_acknowledged++;
+    stats.total_ack_latency += latency;
+    stats.max_ack_latency = std::max(stats.max_ack_latency, latency);
+    
+    XBT_DEBUG("Packet %d acknowledged after %.6f s", ack.packet_id, latency);
+    inflight.erase(it);
+}
+
+double MQTTPublisher::next_retransmit_deadline() const {
+    double deadline = std::numeric_limits<double>::infinity();
+    for (const auto& [id, entry] : inflight) {
+        deadline = std::min(deadline, entry.sent_at + qos_config.retransmit_timeout);
+    }
+    return deadline;
+}
+
+void MQTTPublisher::retransmit_expired() {
+    double now = sg4::Engine::get_clock();
+    
+    for (auto& [id, entry] : inflight) {
+        if (entry.sent_at + qos_config.retransmit_timeout > now) continue;
+        
+        stats.retransmissions++;
+        entry.sent_at = now;
+        
+        if (entry.released) {
+            XBT_DEBUG("Retransmitting PUBREL %d", id);
+            send_control(MQTTControlMessage::ack(MQTTControlMessage::Type::PUBREL,
+                                                 publisher_id, id));
+        } else {
+            XBT_DEBUG("Retransmitting packet %d", id);
+            send(entry.msg, id, true);
+        }
+    }
 }
 
 } // namespace mqtt
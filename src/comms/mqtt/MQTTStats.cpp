@@ -0,0 +1,292 @@
+#include "comms/mqtt/MQTTStats.hpp"
+#include <xbt/log.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+XBT_LOG_NEW_DEFAULT_CATEGORY(mqtt_stats, "MQTT Statistics");
+
+namespace enigma {
+namespace mqtt {
+
+namespace {
+
+// JSON string literal; topics and client ids are arbitrary UTF-8 and may
+// hold quotes, backslashes or control characters
+std::string json_quote(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out + "\"";
+}
+
+// CSV field (RFC 4180): quoted, with quotes doubled, when it holds a
+// separator, a quote or a line break
+std::string csv_field(const std::string& s) {
+    if (s.find_first_of(",\"\r\n") == std::string::npos) return s;
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"') out += "\"\"";
+        else          out += c;
+    }
+    return out + "\"";
+}
+
+double rate(double amount, double duration) {
+    return duration > 0 ? amount / duration : 0.0;
+}
+
+void write_latency_json(std::ofstream& f, const MQTTLatencyHistogram& h) {
+    f << "{\"count\":" << h.count()
+      << ",\"mean\":" << h.mean()
+      << ",\"min\":" << h.min()
+      << ",\"p50\":" << h.percentile(50)
+      << ",\"p95\":" << h.percentile(95)
+      << ",\"p99\":" << h.percentile(99)
+      << ",\"max\":" << h.max() << "}";
+}
+
+void write_latency_csv(std::ofstream& f, const std::string& scope, const std::string& name,
+                       const MQTTLatencyHistogram& h) {
+    f << scope << "," << csv_field(name) << "," << h.count() << ","
+      << h.mean() << "," << h.min() << ","
+      << h.percentile(50) << "," << h.percentile(95) << "," << h.percentile(99) << ","
+      << h.max() << "\n";
+}
+
+} // namespace
+
+// ------------------------------------------------------------------ //
+// MQTTLatencyHistogram
+// ------------------------------------------------------------------ //
+
+MQTTLatencyHistogram::MQTTLatencyHistogram()
+    : buckets(DECADES * BUCKETS_PER_DECADE, 0), total(0), sum(0),
+      min_value(std::numeric_limits<double>::infinity()), max_value(0) {}
+
+void MQTTLatencyHistogram::record(double value) {
+    value = std::max(value, 0.0);
+    
+    size_t index = 0;
+    if (value > MIN_VALUE) {
+        double pos = std::log10(value / MIN_VALUE) * BUCKETS_PER_DECADE;
+        index = std::min(static_cast<size_t>(pos), buckets.size() - 1);
+    }
+    
+    buckets[index]++;
+    total++;
+    sum += value;
+    min_value = std::min(min_value, value);
+    max_value = std::max(max_value, value);
+}
+
+void MQTTLatencyHistogram::merge(const MQTTLatencyHistogram& other) {
+    for (size_t i = 0; i < buckets.size(); i++) {
+        buckets[i] += other.buckets[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    min_value = std::min(min_value, other.min_value);
+    max_value = std::max(max_value, other.max_value);
+}
+
+double MQTTLatencyHistogram::percentile(double p) const {
+    if (total == 0) {
+        return 0.0;
+    }
+    
+    uint64_t rank = static_cast<uint64_t>(std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 * total));
+    rank = std::max<uint64_t>(rank, 1);
+    
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::clamp(bucket_upper_bound(i), min_value, max_value);
+        }
+    }
+    return max_value;
+}
+
+double MQTTLatencyHistogram::bucket_upper_bound(size_t index) {
+    return MIN_VALUE * std::pow(10.0, static_cast<double>(index + 1) / BUCKETS_PER_DECADE);
+}
+
+// ------------------------------------------------------------------ //
+// MQTTBrokerStats
+// ------------------------------------------------------------------ //
+
+MQTTBrokerStats::MQTTBrokerStats(double start)
+    : start_time(start) {}
+
+void MQTTBrokerStats::record_publish(const std::string& topic, size_t size, double now) {
+    auto& t = topics[topic];
+    if (t.messages == 0) {
+        t.first_publish = now;
+    }
+    t.messages++;
+    t.bytes += size;
+    t.last_publish = now;
+}
+
+void MQTTBrokerStats::record_delivery(const std::string& subscriber, const std::string& topic,
+                                      double value) {
+    latency.record(value);
+    subscribers[subscriber].record(value);
+    
+    auto& t = topics[topic];
+    t.deliveries++;
+    t.latency.record(value);
+}
+
+void MQTTBrokerStats::record_depth(const MQTTDepthSample& sample) {
+    depth_samples.push_back(sample);
+}
+
+void MQTTBrokerStats::print(double now) const {
+    double duration = now - start_time;
+    
+    if (latency.count() > 0) {
+        XBT_INFO("  End-to-end latency (%llu deliveries): mean %.6f s, p50 %.6f s, "
+                 "p95 %.6f s, p99 %.6f s, max %.6f s",
+                 static_cast<unsigned long long>(latency.count()), latency.mean(),
+                 latency.percentile(50), latency.percentile(95), latency.percentile(99),
+                 latency.max());
+    }
+    
+    for (const auto& [topic, t] : topics) {
+        XBT_INFO("    Topic '%s': %d msgs (%.3f msg/s, %.1f B/s), p99 latency %.6f s",
+                 topic.c_str(), t.messages, rate(t.messages, duration),
+                 rate(static_cast<double>(t.bytes), duration), t.latency.percentile(99));
+    }
+}
+
+void MQTTBrokerStats::export_csv(const std::string& prefix, double now) const {
+    double duration = now - start_time;
+    
+    {
+        std::string filename = prefix + "_latency.csv";
+        std::ofstream f(filename);
+        if (!f) throw std::runtime_error("Cannot open '" + filename + "' for writing");
+        
+        f << "scope,name,count,mean,min,p50,p95,p99,max\n";
+        f << std::fixed << std::setprecision(9);
+        write_latency_csv(f, "broker", "all", latency);
+        for (const auto& [topic, t] : topics)
+            write_latency_csv(f, "topic", topic, t.latency);
+        for (const auto& [subscriber, h] : subscribers)
+            write_latency_csv(f, "subscriber", subscriber, h);
+        XBT_INFO("Exported latency statistics to '%s'", filename.c_str());
+    }
+    
+    {
+        std::string filename = prefix + "_topics.csv";
+        std::ofstream f(filename);
+        if (!f) throw std::runtime_error("Cannot open '" + filename + "' for writing");
+        
+        f << "topic,messages,bytes,deliveries,first_publish,last_publish,msg_rate,byte_rate\n";
+        f << std::fixed << std::setprecision(6);
+        for (const auto& [topic, t] : topics) {
+            f << csv_field(topic) << "," << t.messages << "," << t.bytes << "," << t.deliveries << ","
+              << t.first_publish << "," << t.last_publish << ","
+              << rate(t.messages, duration) << ","
+              << rate(static_cast<double>(t.bytes), duration) << "\n";
+        }
+        XBT_INFO("Exported %zu topics to '%s'", topics.size(), filename.c_str());
+    }
+    
+    {
+        std::string filename = prefix + "_queue_depth.csv";
+        std::ofstream f(filename);
+        if (!f) throw std::runtime_error("Cannot open '" + filename + "' for writing");
+        
+        f << "time,total_depth,max_depth,inflight,stored_bytes\n";
+        f << std::fixed << std::setprecision(6);
+        for (const auto& s : depth_samples) {
+            f << s.time << "," << s.total_depth << "," << s.max_depth << ","
+              << s.inflight << "," << s.stored_bytes << "\n";
+        }
+        XBT_INFO("Exported %zu queue depth samples to '%s'",
+                 depth_samples.size(), filename.c_str());
+    }
+}
+
+void MQTTBrokerStats::export_json(const std::string& filename, double now) const {
+    std::ofstream f(filename);
+    if (!f) throw std::runtime_error("Cannot open '" + filename + "' for writing");
+    
+    double duration = now - start_time;
+    f << std::fixed << std::setprecision(9);
+    
+    f << "{\n";
+    f << "  \"start_time\": " << start_time << ",\n";
+    f << "  \"end_time\": " << now << ",\n";
+    f << "  \"latency\": ";
+    write_latency_json(f, latency);
+    f << ",\n";
+    
+    f << "  \"topics\": {";
+    bool first = true;
+    for (const auto& [topic, t] : topics) {
+        f << (first ? "\n" : ",\n");
+        first = false;
+        f << "    " << json_quote(topic) << ": {"
+          << "\"messages\":" << t.messages << ","
+          << "\"bytes\":" << t.bytes << ","
+          << "\"deliveries\":" << t.deliveries << ","
+          << "\"msg_rate\":" << rate(t.messages, duration) << ","
+          << "\"byte_rate\":" << rate(static_cast<double>(t.bytes), duration) << ","
+          << "\"latency\":";
+        write_latency_json(f, t.latency);
+        f << "}";
+    }
+    f << "\n  },\n";
+    
+    f << "  \"subscribers\": {";
+    first = true;
+    for (const auto& [subscriber, h] : subscribers) {
+        f << (first ? "\n" : ",\n");
+        first = false;
+        f << "    " << json_quote(subscriber) << ": ";
+        write_latency_json(f, h);
+    }
+    f << "\n  },\n";
+    
+    f << "  \"queue_depth\": [";
+    first = true;
+    for (const auto& s : depth_samples) {
+        f << (first ? "\n" : ",\n");
+        first = false;
+        f << "    {\"time\":" << s.time
+          << ",\"total\":" << s.total_depth
+          << ",\"max\":" << s.max_depth
+          << ",\"inflight\":" << s.inflight
+          << ",\"stored_bytes\":" << s.stored_bytes << "}";
+    }
+    f << "\n  ]\n";
+    f << "}\n";
+    
+    XBT_INFO("Exported broker statistics to '%s'", filename.c_str());
+}
+
+} // namespace mqtt
+} // namespace enigma
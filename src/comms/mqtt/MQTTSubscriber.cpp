@@ -1,4 +1,7 @@
 #include "comms/mqtt/MQTTSubscriber.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 
 XBT_LOG_NEW_DEFAULT_CATEGORY(mqtt_subscriber, "MQTT Subscriber");
 
@@ -7,8 +10,11 @@ namespace mqtt {
 
 namespace sg4 = simgrid::s4u;
 
-MQTTSubscriber::MQTTSubscriber(const std::string& broker, const std::string& sub_id)
-    : broker_name(broker) {
+MQTTSubscriber::MQTTSubscriber(const std::string& broker, const std::string& sub_id,
+                               bool clean_start, double connect_timeout)
+    : broker_name(broker), duplicates_dropped(0), keepalive_interval(0),
+      clean_start(clean_start), connected(false), session_present(false),
+      connect_timeout(connect_timeout), delivery_payload(nullptr), control_payload(nullptr) {
     
     // Generate subscriber ID if not provided
     if (sub_id.empty()) {
@@ -22,16 +28,111 @@ MQTTSubscriber::MQTTSubscriber(const std::string& broker, const std::string& sub
     broker_mbox = sg4::Mailbox::by_name(MQTTBroker::get_broker_mailbox(broker_name));
     my_mbox = sg4::Mailbox::by_name(subscriber_id);
     
+    // QoS 2 releases from the broker are transferred eagerly
+    ctrl_mbox = sg4::Mailbox::by_name(MQTTBroker::get_client_mailbox(subscriber_id));
+    ctrl_mbox->set_receiver(sg4::Actor::self());
+    
+    connect();
+    
     XBT_DEBUG("MQTT Subscriber '%s' initialized (broker: %s)",
               subscriber_id.c_str(), broker_name.c_str());
 }
 
-void MQTTSubscriber::subscribe(const std::string& topic) {
-    auto* ctrl_msg = MQTTControlMessage::subscribe(topic, subscriber_id);
+MQTTSubscriber::~MQTTSubscriber() {
+    // Pending receives would otherwise complete into a destroyed object
+    if (delivery_comm) {
+        delivery_comm->cancel();
+    }
+    if (control_comm) {
+        control_comm->cancel();
+    }
+}
+
+void MQTTSubscriber::connect() {
+    auto* ctrl_msg = MQTTControlMessage::connect(subscriber_id, clean_start);
+    double deadline = std::numeric_limits<double>::infinity();
+    
+    if (connect_timeout < 0) {
+        broker_mbox->put(ctrl_msg, ctrl_msg->wire_size());
+    } else {
+        deadline = sg4::Engine::get_clock() + connect_timeout;
+        try {
+            broker_mbox->put(ctrl_msg, ctrl_msg->wire_size(), connect_timeout);
+        } catch (const simgrid::TimeoutException&) {
+            delete ctrl_msg;  // Never taken by the broker
+            throw std::runtime_error("MQTT subscriber '" + subscriber_id + "': broker '" +
+                                     broker_name + "' did not accept the connection");
+        }
+    }
+    
+    // Releases of the previous connection may still be ahead of the CONNACK
+    while (true) {
+        auto* reply = wait_control(deadline);
+        if (reply == nullptr) {
+            // A late CONNACK stays in the mailbox, the receive must not
+            if (control_comm) {
+                control_comm->cancel();
+                control_comm = nullptr;
+            }
+            throw std::runtime_error("MQTT subscriber '" + subscriber_id +
+                                     "': no CONNACK from broker '" + broker_name +
+                                     "' within the connect timeout");
+        }
+        if (reply->type == MQTTControlMessage::Type::CONNACK) {
+            session_present = reply->session_present;
+            delete reply;
+            break;
+        }
+        handle_control(reply);
+    }
+    connected = true;
+}
+
+void MQTTSubscriber::disconnect() {
+    if (!connected) {
+        return;
+    }
+    
+    auto* ctrl_msg = MQTTControlMessage::disconnect(subscriber_id);
+    broker_mbox->put(ctrl_msg, ctrl_msg->wire_size());
+    connected = false;
+    
+    // No pings while away; the broker forgets a clean session's subscriptions
+    keepalive.start(subscriber_id, broker_mbox, 0);
+    if (clean_start) {
+        subscribed_topics.clear();
+    }
+    
+    XBT_DEBUG("Subscriber '%s' disconnected", subscriber_id.c_str());
+}
+
+bool MQTTSubscriber::reconnect() {
+    if (connected) {
+        return session_present;
+    }
+    
+    connect();
+    keepalive.start(subscriber_id, broker_mbox, keepalive_interval);
+    
+    XBT_DEBUG("Subscriber '%s' reconnected (session present: %d)",
+              subscriber_id.c_str(), session_present);
+    return session_present;
+}
+
+void MQTTSubscriber::set_keepalive(double interval) {
+    keepalive_interval = interval;
+    if (connected) {
+        keepalive.start(subscriber_id, broker_mbox, interval);
+    }
+}
+
+void MQTTSubscriber::subscribe(const std::string& topic, int qos) {
+    auto* ctrl_msg = MQTTControlMessage::subscribe(topic, subscriber_id, qos);
     
-    XBT_DEBUG("Subscribing to topic '%s'", topic.c_str());
+    XBT_DEBUG("Subscribing to topic '%s' (QoS %d)", topic.c_str(), qos);
     
-    broker_mbox->put(ctrl_msg, sizeof(MQTTControlMessage));
+    broker_mbox->put(ctrl_msg, ctrl_msg->wire_size());
+    keepalive.touch();
     subscribed_topics.push_back(topic);
 }
 
@@ -40,7 +141,8 @@ void MQTTSubscriber::unsubscribe(const std::string& topic) {
     
     XBT_DEBUG("Unsubscribing from topic '%s'", topic.c_str());
     
-    broker_mbox->put(ctrl_msg, sizeof(MQTTControlMessage));
+    broker_mbox->put(ctrl_msg, ctrl_msg->wire_size());
+    keepalive.touch();
     
     // Remove from local list
     auto it = std::find(subscribed_topics.begin(), subscribed_topics.end(), topic);
@@ -50,31 +152,191 @@ void MQTTSubscriber::unsubscribe(const std::string& topic) {
 }
 
 std::shared_ptr<MQTTMessage> MQTTSubscriber::receive(double timeout) {
-    try {
-        std::shared_ptr<MQTTMessage>* msg_ptr;
-        
-        if (timeout > 0) {
-            msg_ptr = my_mbox->get<std::shared_ptr<MQTTMessage>>(timeout);
-        } else {
-            msg_ptr = my_mbox->get<std::shared_ptr<MQTTMessage>>();
+    double deadline = timeout > 0 ? sg4::Engine::get_clock() + timeout
+                                  : std::numeric_limits<double>::infinity();
+    
+    while (true) {
+        MQTTDelivery* delivery_ptr = wait_delivery(deadline);
+        if (delivery_ptr == nullptr) {
+            XBT_DEBUG("Receive timeout");
+            return nullptr;
         }
         
-        auto msg = *msg_ptr;
-        delete msg_ptr;
+        MQTTDelivery delivery = *delivery_ptr;
+        delete delivery_ptr;
         
-        XBT_DEBUG("Received message from topic '%s' (size: %zu bytes)",
-                  msg->topic.c_str(), msg->size);
+        if (!acknowledge(delivery)) {
+            continue;  // Retransmitted QoS 2 delivery already handed out
+        }
+        
+        auto msg = delivery.message;
+        dispatcher.decompress(*msg);
+        XBT_DEBUG("Received message from topic '%s' (size: %zu bytes, QoS: %d)",
+                  msg->topic.c_str(), msg->size, delivery.qos);
         
         return msg;
+    }
+}
+
+std::vector<std::shared_ptr<MQTTMessage>> MQTTSubscriber::receive_batch(size_t max_n,
+                                                                        double timeout) {
+    std::vector<std::shared_ptr<MQTTMessage>> batch;
+    if (max_n == 0) {
+        return batch;
+    }
+    
+    auto first = receive(timeout);
+    if (!first) {
+        return batch;
+    }
+    batch.push_back(first);
+    
+    // Drain messages the broker is already waiting to hand over
+    while (batch.size() < max_n) {
+        auto* delivery_ptr = poll_delivery();
+        if (delivery_ptr == nullptr) {
+            break;
+        }
+        MQTTDelivery delivery = *delivery_ptr;
+        delete delivery_ptr;
         
+        if (acknowledge(delivery)) {
+            dispatcher.decompress(*delivery.message);
+            batch.push_back(delivery.message);
+        }
+    }
+    process_control();
+    
+    XBT_DEBUG("Received batch of %zu messages", batch.size());
+    return batch;
+}
+
+void MQTTSubscriber::on_message(const std::string& topic_filter, MQTTMessageHandler handler) {
+    dispatcher.on_message(topic_filter, std::move(handler));
+}
+
+size_t MQTTSubscriber::run(double idle_timeout, size_t max_messages) {
+    return dispatcher.run([this](size_t max_n, double timeout) {
+                              return receive_batch(max_n, timeout);
+                          },
+                          idle_timeout, max_messages);
+}
+
+bool MQTTSubscriber::acknowledge(const MQTTDelivery& delivery) {
+    if (delivery.qos == 1) {
+        send_to_broker(MQTTControlMessage::ack(MQTTControlMessage::Type::PUBACK,
+                                               subscriber_id, delivery.packet_id));
+    } else if (delivery.qos == 2) {
+        send_to_broker(MQTTControlMessage::ack(MQTTControlMessage::Type::PUBREC,
+                                               subscriber_id, delivery.packet_id));
+        
+        if (!qos2_received.insert(delivery.packet_id).second) {
+            duplicates_dropped++;
+            XBT_DEBUG("Dropping duplicate QoS 2 delivery %d", delivery.packet_id);
+            return false;
+        }
+    }
+    return true;
+}
+
+MQTTDelivery* MQTTSubscriber::wait_delivery(double deadline) {
+    while (true) {
+        if (!delivery_comm) {
+            delivery_comm = my_mbox->get_async<MQTTDelivery>(&delivery_payload);
+        }
+        
+        // Wait on both mailboxes: a PUBREL left unanswered while blocked
+        // here would keep the QoS 2 delivery in the broker's window
+        sg4::ActivitySet pending;
+        pending.push(delivery_comm);
+        pending.push(post_control());
+        
+        auto done = wait_any(pending, deadline);
+        if (!done) {
+            return nullptr;  // Both receives stay posted for the next call
+        }
+        if (done == control_comm) {
+            control_comm = nullptr;
+            handle_control(control_payload);
+            continue;
+        }
+        
+        delivery_comm = nullptr;
+        return delivery_payload;
+    }
+}
+
+MQTTDelivery* MQTTSubscriber::poll_delivery() {
+    // A receive left posted by a timeout is first in line
+    if (delivery_comm) {
+        if (!delivery_comm->test()) {
+            return nullptr;
+        }
+        delivery_comm = nullptr;
+        return delivery_payload;
+    }
+    return my_mbox->listen() ? my_mbox->get<MQTTDelivery>() : nullptr;
+}
+
+MQTTControlMessage* MQTTSubscriber::wait_control(double deadline) {
+    sg4::ActivitySet pending;
+    pending.push(post_control());
+    if (!wait_any(pending, deadline)) {
+        return nullptr;
+    }
+    control_comm = nullptr;
+    return control_payload;
+}
+
+sg4::CommPtr MQTTSubscriber::post_control() {
+    if (!control_comm) {
+        control_comm = ctrl_mbox->get_async<MQTTControlMessage>(&control_payload);
+    }
+    return control_comm;
+}
+
+sg4::ActivityPtr MQTTSubscriber::wait_any(sg4::ActivitySet& pending, double deadline) {
+    if (deadline == std::numeric_limits<double>::infinity()) {
+        return pending.wait_any();
+    }
+    
+    try {
+        return pending.wait_any_for(std::max(deadline - sg4::Engine::get_clock(), 0.0));
     } catch (const simgrid::TimeoutException&) {
-        XBT_DEBUG("Receive timeout");
         return nullptr;
     }
 }
 
+void MQTTSubscriber::process_control() {
+    while (post_control()->test()) {
+        control_comm = nullptr;
+        handle_control(control_payload);
+    }
+}
+
+void MQTTSubscriber::handle_control(MQTTControlMessage* ctrl_msg) {
+    if (ctrl_msg->type == MQTTControlMessage::Type::PUBREL) {
+        qos2_received.erase(ctrl_msg->packet_id);
+        send_to_broker(MQTTControlMessage::ack(MQTTControlMessage::Type::PUBCOMP,
+                                               subscriber_id, ctrl_msg->packet_id));
+    }
+    
+    delete ctrl_msg;
+}
+
+void MQTTSubscriber::send_to_broker(MQTTControlMessage* msg) {
+    // Acknowledgements must not block: the broker may itself be blocked
+    // delivering to this subscriber
+    broker_mbox->put_init(msg, msg->wire_size())->detach();
+    keepalive.touch();
+}
+
 bool MQTTSubscriber::has_messages() const {
-    return my_mbox->ready();
+    // A posted receive makes the mailbox look busy; ask the receive instead
+    if (delivery_comm) {
+        return delivery_comm->test();
+    }
+    return my_mbox->listen();
 }
 
 const std::string& MQTTSubscriber::get_mailbox_name() const {
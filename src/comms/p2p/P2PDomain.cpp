@@ -0,0 +1,58 @@
+#include "comms/p2p/P2PDomain.hpp"
+#include <algorithm>
+
+namespace enigma {
+namespace p2p {
+
+P2PDomain::Registry& P2PDomain::registry(const std::string& domain) {
+    static std::map<std::string, Registry> registries;
+    return registries[domain];
+}
+
+void P2PDomain::add_publisher(const std::string& domain, const std::string& publisher) {
+    registry(domain).publishers.insert(publisher);
+}
+
+void P2PDomain::remove_publisher(const std::string& domain, const std::string& publisher) {
+    registry(domain).publishers.erase(publisher);
+}
+
+std::vector<std::string> P2PDomain::get_publishers(const std::string& domain) {
+    const auto& publishers = registry(domain).publishers;
+    return std::vector<std::string>(publishers.begin(), publishers.end());
+}
+
+void P2PDomain::add_subscription(const std::string& domain, const Subscription& sub) {
+    auto& subs = registry(domain).subscriptions;
+    auto it = std::find_if(subs.begin(), subs.end(), [&](const Subscription& s) {
+        return s.subscriber == sub.subscriber && s.filter == sub.filter;
+    });
+    if (it == subs.end()) {
+        subs.push_back(sub);
+    }
+}
+
+void P2PDomain::remove_subscription(const std::string& domain, const Subscription& sub) {
+    auto& subs = registry(domain).subscriptions;
+    subs.erase(std::remove_if(subs.begin(), subs.end(), [&](const Subscription& s) {
+                   return s.subscriber == sub.subscriber && s.filter == sub.filter;
+               }),
+               subs.end());
+}
+
+std::vector<P2PDomain::Subscription> P2PDomain::get_subscriptions(const std::string& domain) {
+    return registry(domain).subscriptions;
+}
+
+std::string P2PDomain::get_data_mailbox(const std::string& domain,
+                                        const std::string& subscriber) {
+    return "p2p_" + domain + "_" + subscriber;
+}
+
+std::string P2PDomain::get_discovery_mailbox(const std::string& domain,
+                                             const std::string& publisher) {
+    return "p2p_" + domain + "_" + publisher + "_discovery";
+}
+
+} // namespace p2p
+} // namespace enigma
@@ -0,0 +1,192 @@
+#include "comms/p2p/P2PPublisher.hpp"
+#include <algorithm>
+#include <limits>
+
+XBT_LOG_NEW_DEFAULT_CATEGORY(p2p_publisher, "P2P Publisher");
+
+namespace enigma {
+namespace p2p {
+
+namespace sg4 = simgrid::s4u;
+
+P2PPublisher::P2PPublisher(const std::string& dom, const std::string& pub_id)
+    : domain(dom), reliable(true), send_timeout(10.0), compress_min_size(0) {
+    
+    // Generate publisher ID if not provided
+    if (pub_id.empty()) {
+        auto* host = sg4::this_actor::get_host();
+        publisher_id = std::string(host->get_cname()) + "_p2ppub_" +
+                      std::to_string(sg4::this_actor::get_pid());
+    } else {
+        publisher_id = pub_id;
+    }
+    
+    // Announcements are transferred as soon as subscribers send them
+    discovery_mbox = sg4::Mailbox::by_name(P2PDomain::get_discovery_mailbox(domain, publisher_id));
+    discovery_mbox->set_receiver(sg4::Actor::self());
+    
+    // Subscriptions made before we joined, as learnt during participant discovery
+    P2PDomain::add_publisher(domain, publisher_id);
+    matched = P2PDomain::get_subscriptions(domain);
+    
+    XBT_DEBUG("P2P Publisher '%s' joined domain '%s' (%zu subscriptions known)",
+              publisher_id.c_str(), domain.c_str(), matched.size());
+}
+
+P2PPublisher::~P2PPublisher() {
+    P2PDomain::remove_publisher(domain, publisher_id);
+}
+
+void P2PPublisher::publish(const std::string& topic,
+                           const std::string& payload,
+                           size_t size,
+                           int qos) {
+    process_discovery();
+    
+    auto msg = std::make_shared<MQTTMessage>(topic, payload, size, publisher_id, qos);
+    mqtt::compress_message(codec, compress_min_size, *msg, stats);
+    std::vector<std::string> targets = match(topic);
+    size_t sample_size = P2PWire::sample(*msg);
+    
+    XBT_DEBUG("Publishing to topic '%s' (size: %zu bytes) to %zu subscribers",
+              topic.c_str(), size, targets.size());
+    
+    // One copy per subscriber, all sent from this host in parallel
+    std::vector<Copy> copies;
+    for (const auto& subscriber : targets) {
+        auto* mbox = sg4::Mailbox::by_name(P2PDomain::get_data_mailbox(domain, subscriber));
+        auto* sample = new P2PSample(msg);
+        if (reliable) {
+            copies.push_back({subscriber, sample, mbox->put_async(sample, sample_size)});
+        } else {
+            // Freed by SimGrid if the subscriber never takes it
+            mbox->put_init(sample, sample_size)
+                ->detach([](void* data) { delete static_cast<P2PSample*>(data); });
+        }
+    }
+    size_t sent = targets.size() - wait_copies(copies);
+    
+    stats.messages_sent++;
+    stats.deliveries += static_cast<int>(sent);
+    stats.bytes_sent += sample_size * sent;
+}
+
+int P2PPublisher::wait_copies(std::vector<Copy>& copies) {
+    if (copies.empty()) {
+        return 0;
+    }
+    
+    // An UNSUBSCRIBE that arrived meanwhile means nobody may take the copy
+    process_discovery();
+    
+    sg4::ActivitySet pending;
+    for (auto& copy : copies) {
+        if (is_matched(copy.subscriber) || copy.comm->test()) {
+            pending.push(copy.comm);
+        } else {
+            copy.comm->cancel();
+            copy.comm = nullptr;
+        }
+    }
+    
+    double deadline = send_timeout >= 0 ? sg4::Engine::get_clock() + send_timeout
+                                        : std::numeric_limits<double>::infinity();
+    try {
+        while (!pending.empty()) {
+            if (send_timeout < 0) {
+                pending.wait_any();
+            } else {
+                pending.wait_any_for(std::max(deadline - sg4::Engine::get_clock(), 0.0));
+            }
+        }
+    } catch (const simgrid::TimeoutException&) {
+        XBT_DEBUG("Copies not taken within %.2f s", send_timeout);
+    }
+    
+    // Copies still waiting: the subscriber stopped receiving or is gone
+    int cancelled = 0;
+    for (auto& copy : copies) {
+        if (copy.comm && copy.comm->test()) {
+            continue;
+        }
+        if (copy.comm) {
+            copy.comm->cancel();
+            drop(copy.subscriber);
+        }
+        delete copy.sample;
+        cancelled++;
+    }
+    stats.copies_cancelled += cancelled;
+    return cancelled;
+}
+
+void P2PPublisher::drop(const std::string& subscriber) {
+    auto it = std::remove_if(matched.begin(), matched.end(),
+                             [&](const P2PDomain::Subscription& s) {
+                                 return s.subscriber == subscriber;
+                             });
+    if (it == matched.end()) {
+        return;
+    }
+    matched.erase(it, matched.end());
+    stats.subscribers_dropped++;
+    XBT_WARN("Subscriber '%s' did not take a message within %.2f s, dropping it",
+             subscriber.c_str(), send_timeout);
+}
+
+bool P2PPublisher::is_matched(const std::string& subscriber) const {
+    return std::any_of(matched.begin(), matched.end(),
+                       [&](const P2PDomain::Subscription& s) { return s.subscriber == subscriber; });
+}
+
+void P2PPublisher::publish(const std::string& topic,
+                           const std::string& payload,
+                           int qos) {
+    // Automatic size calculation
+    size_t size = payload.size();
+    publish(topic, payload, size, qos);
+}
+
+size_t P2PPublisher::get_subscriber_count(const std::string& topic) {
+    process_discovery();
+    return match(topic).size();
+}
+
+void P2PPublisher::process_discovery() {
+    while (discovery_mbox->ready()) {
+        auto* announcement = discovery_mbox->get<P2PAnnouncement>();
+        stats.announcements++;
+        
+        auto it = std::find_if(matched.begin(), matched.end(),
+                               [&](const P2PDomain::Subscription& s) {
+                                   return s.subscriber == announcement->subscriber &&
+                                          s.filter == announcement->filter;
+                               });
+                               
+        if (announcement->type == P2PAnnouncement::Type::SUBSCRIBE && it == matched.end()) {
+            matched.push_back({announcement->subscriber, announcement->filter});
+            XBT_DEBUG("Discovered subscriber '%s' on '%s'",
+                      announcement->subscriber.c_str(), announcement->filter.c_str());
+        } else if (announcement->type == P2PAnnouncement::Type::UNSUBSCRIBE &&
+                   it != matched.end()) {
+            matched.erase(it);
+        }
+        
+        delete announcement;
+    }
+}
+
+std::vector<std::string> P2PPublisher::match(const std::string& topic) const {
+    // A subscriber matching through several filters gets the message once
+    std::vector<std::string> targets;
+    for (const auto& sub : matched) {
+        if (mqtt::MQTTBroker::topic_matches(sub.filter, topic) &&
+            std::find(targets.begin(), targets.end(), sub.subscriber) == targets.end()) {
+            targets.push_back(sub.subscriber);
+        }
+    }
+    return targets;
+}
+
+} // namespace p2p
+} // namespace enigma
@@ -0,0 +1,154 @@
+#include "comms/p2p/P2PSubscriber.hpp"
+#include <algorithm>
+
+XBT_LOG_NEW_DEFAULT_CATEGORY(p2p_subscriber, "P2P Subscriber");
+
+namespace enigma {
+namespace p2p {
+
+namespace sg4 = simgrid::s4u;
+
+P2PSubscriber::P2PSubscriber(const std::string& dom, const std::string& sub_id)
+    : domain(dom), announcements_sent(0) {
+    
+    // Generate subscriber ID if not provided
+    if (sub_id.empty()) {
+        auto* host = sg4::this_actor::get_host();
+        subscriber_id = std::string(host->get_cname()) + "_p2psub_" +
+                       std::to_string(sg4::this_actor::get_pid());
+    } else {
+        subscriber_id = sub_id;
+    }
+    
+    my_mbox = sg4::Mailbox::by_name(P2PDomain::get_data_mailbox(domain, subscriber_id));
+    
+    XBT_DEBUG("P2P Subscriber '%s' joined domain '%s'", subscriber_id.c_str(), domain.c_str());
+}
+
+P2PSubscriber::~P2PSubscriber() {
+    // Leave the domain so publishers stop sending to us
+    for (const auto& topic : subscribed_topics) {
+        P2PDomain::remove_subscription(domain, {subscriber_id, topic});
+        announce(P2PAnnouncement::Type::UNSUBSCRIBE, topic);
+    }
+}
+
+void P2PSubscriber::subscribe(const std::string& topic, int qos) {
+    (void)qos;
+    if (std::find(subscribed_topics.begin(), subscribed_topics.end(), topic) !=
+        subscribed_topics.end()) {
+        return;
+    }
+    
+    XBT_DEBUG("Subscribing to topic '%s'", topic.c_str());
+    
+    P2PDomain::add_subscription(domain, {subscriber_id, topic});
+    announce(P2PAnnouncement::Type::SUBSCRIBE, topic);
+    subscribed_topics.push_back(topic);
+}
+
+void P2PSubscriber::unsubscribe(const std::string& topic) {
+    auto it = std::find(subscribed_topics.begin(), subscribed_topics.end(), topic);
+    if (it == subscribed_topics.end()) {
+        return;
+    }
+    
+    XBT_DEBUG("Unsubscribing from topic '%s'", topic.c_str());
+    
+    P2PDomain::remove_subscription(domain, {subscriber_id, topic});
+    announce(P2PAnnouncement::Type::UNSUBSCRIBE, topic);
+    subscribed_topics.erase(it);
+}
+
+void P2PSubscriber::announce(P2PAnnouncement::Type type, const std::string& topic) {
+    // Publishers joining later read the subscription from the domain instead
+    for (const auto& publisher : P2PDomain::get_publishers(domain)) {
+        auto* announcement = new P2PAnnouncement(type, subscriber_id, topic);
+        sg4::Mailbox::by_name(P2PDomain::get_discovery_mailbox(domain, publisher))
+            ->put_init(announcement, P2PWire::announcement(topic.size()))
+            ->detach([](void* data) { delete static_cast<P2PAnnouncement*>(data); });
+        announcements_sent++;
+    }
+}
+
+std::shared_ptr<MQTTMessage> P2PSubscriber::receive(double timeout) {
+    double deadline = sg4::Engine::get_clock() + timeout;
+    
+    while (true) {
+        try {
+            P2PSample* sample;
+            if (timeout > 0) {
+                double remaining = deadline - sg4::Engine::get_clock();
+                if (remaining <= 0) {
+                    XBT_DEBUG("Receive timeout");
+                    return nullptr;
+                }
+                sample = my_mbox->get<P2PSample>(remaining);
+            } else {
+                sample = my_mbox->get<P2PSample>();
+            }
+            
+            auto msg = sample->message;
+            delete sample;
+            dispatcher.decompress(*msg);
+            
+            XBT_DEBUG("Received message from topic '%s' (size: %zu bytes)",
+                      msg->topic.c_str(), msg->size);
+            return msg;
+            
+        } catch (const simgrid::TimeoutException&) {
+            XBT_DEBUG("Receive timeout");
+            return nullptr;
+        } catch (const simgrid::CancelException&) {
+            // The publisher's send timeout expired during the transfer
+            XBT_DEBUG("Transfer cancelled by its publisher");
+        }
+    }
+}
+
+std::vector<std::shared_ptr<MQTTMessage>> P2PSubscriber::receive_batch(size_t max_n,
+                                                                       double timeout) {
+    std::vector<std::shared_ptr<MQTTMessage>> batch;
+    if (max_n == 0) {
+        return batch;
+    }
+    
+    auto first = receive(timeout);
+    if (!first) {
+        return batch;
+    }
+    batch.push_back(first);
+    
+    // Drain messages publishers are already waiting to hand over
+    try {
+        while (batch.size() < max_n && my_mbox->listen()) {
+            auto* sample = my_mbox->get<P2PSample>();
+            dispatcher.decompress(*sample->message);
+            batch.push_back(sample->message);
+            delete sample;
+        }
+    } catch (const simgrid::CancelException&) {
+        XBT_DEBUG("Transfer cancelled by its publisher");
+    }
+    
+    XBT_DEBUG("Received batch of %zu messages", batch.size());
+    return batch;
+}
+
+void P2PSubscriber::on_message(const std::string& topic_filter, MQTTMessageHandler handler) {
+    dispatcher.on_message(topic_filter, std::move(handler));
+}
+
+size_t P2PSubscriber::run(double idle_timeout, size_t max_messages) {
+    return dispatcher.run([this](size_t max_n, double timeout) {
+                              return receive_batch(max_n, timeout);
+                          },
+                          idle_timeout, max_messages);
+}
+
+bool P2PSubscriber::has_messages() const {
+    return my_mbox->listen();
+}
+
+} // namespace p2p
+} // namespace enigma
@@ -4,15 +4,23 @@
  */
 
 #include "mobility/MobilityManager.hpp"
+#include "mobility/TracePack.hpp"
 
 #include <xbt/log.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
+#include <limits>
+#include <map>
 #include <set>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 
 XBT_LOG_NEW_DEFAULT_CATEGORY(mobility_manager, "ENIGMA Mobility Manager");
 
@@ -59,7 +67,9 @@ std::string MobilityManager::detect_mobility_dir(simgrid::s4u::Engine& engine) c
     return {};
 }
 
-MobilityManager::MobilityManager(simgrid::s4u::Engine& engine) {
+MobilityManager::MobilityManager(simgrid::s4u::Engine& engine,
+                                   const MobilityOptions& options)
+    : options_(options) {
     std::string dir = detect_mobility_dir(engine);
     if (dir.empty()) {
         XBT_INFO("No mobility_dir property found – mobility module inactive");
@@ -67,13 +77,15 @@ MobilityManager::MobilityManager(simgrid::s4u::Engine& engine) {
     }
     coords_dir_ = dir;
     load_directory(dir);
+    build_host_table(engine);
 }
 
 MobilityManager::MobilityManager(simgrid::s4u::Engine& engine,
-                                   const std::string& coords_dir)
-    : coords_dir_(coords_dir) {
-    (void)engine;
+                                   const std::string& coords_dir,
+                                   const MobilityOptions& options)
+    : coords_dir_(coords_dir), options_(options) {
     load_directory(coords_dir);
+    build_host_table(engine);
 }
 
 // ------------------------------------------------------------------ //
@@ -81,60 +93,354 @@ MobilityManager::MobilityManager(simgrid::s4u::Engine& engine,
 // ------------------------------------------------------------------ //
 
 void MobilityManager::load_directory(const std::string& dir_path) {
+    if (fs::is_regular_file(dir_path)) {
+        if (options_.stream_chunk > 0)
+            XBT_INFO("MobilityManager: streaming applies to per-device CSV directories; "
+                     "loading '%s' whole", dir_path.c_str());
+        if (TracePack::is_pack(dir_path)) load_pack(dir_path);
+        else                              load_long_csv(dir_path);
+        return;
+    }
     if (!fs::exists(dir_path) || !fs::is_directory(dir_path)) {
         XBT_WARN("Mobility dir '%s' does not exist or is not a directory", dir_path.c_str());
         return;
     }
 
-    int loaded = 0;
+    std::vector<fs::path> files;
     for (const auto& entry : fs::directory_iterator(dir_path)) {
         if (!entry.is_regular_file()) continue;
         if (entry.path().extension() != ".csv") continue;
-
-        try {
-            MobilityTrace t(entry.path().string());
-            XBT_DEBUG("Loaded trace '%s': %zu waypoints [%.1f – %.1f s]",
-                      t.device_name().c_str(), t.size(), t.t_min(), t.t_max());
-            traces_.emplace(t.device_name(), std::move(t));
-            ++loaded;
-        } catch (const std::exception& ex) {
-            XBT_WARN("Could not load '%s': %s", entry.path().c_str(), ex.what());
+        files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    // Parse on a pool of workers; each file has its own result slot, so the
+    // outcome does not depend on scheduling
+    struct Result {
+        std::optional<MobilityTrace> trace;
+        std::unique_ptr<TraceStream> stream;  // streaming mode
+        std::string                  error;
+    };
+    std::vector<Result> results(files.size());
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]() {
+        for (std::size_t i; (i = next.fetch_add(1)) < files.size();) {
+            try {
+                if (options_.stream_chunk > 0) {
+                    results[i].stream = std::make_unique<TraceStream>(
+                        files[i].string(), options_.stream_chunk, options_.window);
+                    results[i].trace.emplace(results[i].stream->first());
+                } else {
+                    results[i].trace.emplace(files[i].string(), options_.window);
+                }
+            } catch (const std::exception& ex) {
+                results[i].error = ex.what();
+            }
+        }
+    };
+
+    unsigned workers = options_.load_workers ? options_.load_workers
+                                             : std::max(1u, std::thread::hardware_concurrency());
+    workers = static_cast<unsigned>(std::min<std::size_t>(workers, files.size()));
+
+    auto start = std::chrono::steady_clock::now();
+    if (workers <= 1) {
+        worker();
+    } else {
+        std::vector<std::thread> pool;
+        for (unsigned w = 0; w < workers; ++w) pool.emplace_back(worker);
+        for (auto& t : pool) t.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Merge in file order (logging stays on this thread)
+    std::map<std::string, MobilityTrace> loaded;  // by name, so handles follow the name order
+    std::map<std::string, std::unique_ptr<TraceStream>> streams;
+    std::size_t rows = 0, malformed = 0;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        if (!results[i].trace) {
+            XBT_WARN("Could not load '%s': %s", files[i].c_str(), results[i].error.c_str());
+            continue;
         }
+        MobilityTrace& t = *results[i].trace;
+        XBT_DEBUG("Loaded trace '%s': %zu waypoints [%.1f – %.1f s], %zu malformed rows",
+                  t.device_name().c_str(), t.size(), t.t_min(), t.t_max(),
+                  t.malformed_rows());
+        rows += t.size();
+        malformed += t.malformed_rows();
+        std::string name = t.device_name();
+        if (results[i].stream) streams.emplace(name, std::move(results[i].stream));
+        loaded.emplace(std::move(name), std::move(t));
+    }
+    results.clear();
+
+    add_devices(loaded, std::move(streams));
+    XBT_INFO("MobilityManager: loaded %zu traces (%zu rows) from '%s' in %.3f s "
+             "(%.0f files/s, %.0f rows/s, %u workers)",
+             devices_.size(), rows, dir_path.c_str(), elapsed,
+             elapsed > 0 ? files.size() / elapsed : 0.0,
+             elapsed > 0 ? rows / elapsed : 0.0, std::max(workers, 1u));
+    if (options_.stream_chunk > 0)
+        XBT_INFO("MobilityManager: streaming traces in chunks of %.0f s", options_.stream_chunk);
+    if (malformed > 0)
+        XBT_WARN("MobilityManager: skipped %zu malformed rows (bad timestamp/lat/lon)", malformed);
+}
+
+void MobilityManager::load_pack(const std::string& pack_path) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<MobilityTrace> traces;
+    try {
+        traces = TracePack::open(pack_path, options_.window);
+    } catch (const std::exception& ex) {
+        XBT_WARN("Could not load '%s': %s", pack_path.c_str(), ex.what());
+        return;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::map<std::string, MobilityTrace> loaded;
+    std::size_t rows = 0;
+    for (auto& t : traces) {
+        rows += t.size();
+        std::string name = t.device_name();
+        loaded.emplace(std::move(name), std::move(t));
+    }
+    add_devices(loaded);
+    XBT_INFO("MobilityManager: mapped %zu traces (%zu rows) from pack '%s' in %.3f s",
+             devices_.size(), rows, pack_path.c_str(), elapsed);
+}
+
+void MobilityManager::load_long_csv(const std::string& csv_path) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<MobilityTrace> traces;
+    std::size_t orphans = 0;
+    try {
+        traces = MobilityTrace::load_long_csv(csv_path, options_.window, &orphans);
+    } catch (const std::exception& ex) {
+        XBT_WARN("Could not load '%s': %s", csv_path.c_str(), ex.what());
+        return;
     }
-    XBT_INFO("MobilityManager: loaded %d traces from '%s'", loaded, dir_path.c_str());
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::map<std::string, MobilityTrace> loaded;
+    std::size_t rows = 0, malformed = orphans;
+    for (auto& t : traces) {
+        rows += t.size();
+        malformed += t.malformed_rows();
+        std::string name = t.device_name();
+        loaded.emplace(std::move(name), std::move(t));
+    }
+    add_devices(loaded);
+    XBT_INFO("MobilityManager: loaded %zu traces (%zu rows) from long-format '%s' in %.3f s "
+             "(%.0f rows/s)",
+             devices_.size(), rows, csv_path.c_str(), elapsed,
+             elapsed > 0 ? rows / elapsed : 0.0);
+    if (malformed > 0)
+        XBT_WARN("MobilityManager: skipped %zu malformed rows (bad device/timestamp/lat/lon)",
+                 malformed);
+}
+
+void MobilityManager::add_devices(std::map<std::string, MobilityTrace>& traces,
+                                  std::map<std::string, std::unique_ptr<TraceStream>> streams) {
+    devices_.reserve(devices_.size() + traces.size());
+    for (auto& [name, trace] : traces) {
+        if (index_.count(name)) continue;  // first source of a device wins
+        auto h = static_cast<DeviceHandle>(devices_.size());
+        index_.emplace(name, h);
+        handles_.push_back(h);
+        auto stream = streams.find(name);
+        devices_.push_back(Device{name, std::move(trace), {},
+                                  stream != streams.end() ? std::move(stream->second) : nullptr});
+    }
+}
+
+void MobilityManager::build_host_table(simgrid::s4u::Engine& engine) {
+    for (auto* host : engine.get_all_hosts()) {
+        DeviceHandle h = handle_of(host->get_name());
+        if (h != NO_DEVICE) hosts_.emplace(host, h);
+    }
+    if (hosts_.size() < devices_.size())
+        XBT_INFO("MobilityManager: %zu of %zu traces match a host",
+                 hosts_.size(), devices_.size());
 }
 
 // ------------------------------------------------------------------ //
 // Query
 // ------------------------------------------------------------------ //
 
+const MobilityTrace& MobilityManager::Device::at(double sim_t) const noexcept {
+    if (stream) {
+        try {
+            if (stream->page(sim_t, trace)) cursor = {};
+        } catch (const std::exception& ex) {
+            XBT_WARN("Trace stream of '%s' stopped at t=%.1f s: %s",
+                     name.c_str(), sim_t, ex.what());
+        }
+    }
+    return trace;
+}
+
+const MobilityManager::Device*
+MobilityManager::find(const std::string& device_name) const noexcept {
+    auto it = index_.find(device_name);
+    return it == index_.end() ? nullptr : &devices_[it->second];
+}
+
 bool MobilityManager::has_trace(const std::string& device_name) const noexcept {
-    return traces_.find(device_name) != traces_.end();
+    return find(device_name) != nullptr;
 }
 
 std::optional<MobilityPosition>
 MobilityManager::position_at(const std::string& device_name, double sim_t) const noexcept {
-    auto it = traces_.find(device_name);
-    if (it == traces_.end()) return std::nullopt;
-    return it->second.position_at(sim_t);
+    const Device* dev = find(device_name);
+    if (!dev) return std::nullopt;
+    return dev->at(sim_t).position_at(sim_t, dev->cursor);
+}
+
+std::optional<MobilityPosition>
+MobilityManager::position_at(const std::string& device_name, double sim_t,
+                             TraceCursor& cursor) const noexcept {
+    const Device* dev = find(device_name);
+    if (!dev) return std::nullopt;
+    return dev->at(sim_t).position_at(sim_t, cursor);
+}
+
+std::optional<PositionView>
+MobilityManager::view_at(const std::string& device_name, double sim_t,
+                         double* extra_out) const noexcept {
+    const Device* dev = find(device_name);
+    if (!dev) return std::nullopt;
+    return dev->at(sim_t).view_at(sim_t, &dev->cursor, extra_out);
+}
+
+const MobilityTrace* MobilityManager::trace(const std::string& device_name) const noexcept {
+    const Device* dev = find(device_name);
+    return dev ? &dev->trace : nullptr;
+}
+
+DeviceHandle MobilityManager::handle_of(const std::string& device_name) const noexcept {
+    auto it = index_.find(device_name);
+    return it == index_.end() ? NO_DEVICE : it->second;
+}
+
+DeviceHandle MobilityManager::handle_of(const simgrid::s4u::Host* host) const noexcept {
+    auto it = hosts_.find(host);
+    return it == hosts_.end() ? NO_DEVICE : it->second;
+}
+
+std::optional<MobilityPosition>
+MobilityManager::position_at(DeviceHandle h, double sim_t) const noexcept {
+    if (!has_trace(h)) return std::nullopt;
+    const Device& dev = devices_[h];
+    return dev.at(sim_t).position_at(sim_t, dev.cursor);
+}
+
+std::optional<PositionView>
+MobilityManager::view_at(DeviceHandle h, double sim_t, double* extra_out) const noexcept {
+    if (!has_trace(h)) return std::nullopt;
+    const Device& dev = devices_[h];
+    return dev.at(sim_t).view_at(sim_t, &dev.cursor, extra_out);
+}
+
+void MobilityManager::positions_at(const DeviceHandle* handles, std::size_t count,
+                                   double sim_t, PositionView* out) const noexcept {
+    constexpr std::size_t BLOCK = 256;
+    constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+
+    // Structure-of-arrays scratch for one block (stack, no allocation)
+    double ts[BLOCK], lat0[BLOCK], lat1[BLOCK], lon0[BLOCK], lon1[BLOCK], frac[BLOCK];
+
+    for (std::size_t base = 0; base < count; base += BLOCK) {
+        const std::size_t n = std::min(BLOCK, count - base);
+
+        // Gather: locate each device's segment (scalar, cursor-driven)
+        for (std::size_t i = 0; i < n; ++i) {
+            const DeviceHandle h = handles[base + i];
+            if (h >= devices_.size()) {
+                ts[i] = lat0[i] = lat1[i] = lon0[i] = lon1[i] = NaN;
+                frac[i] = 0.0;
+                continue;
+            }
+            const Device& dev = devices_[h];
+            const MobilityTrace& trace = dev.at(sim_t);
+            std::size_t a, b;
+            trace.locate(sim_t, &dev.cursor, a, b, frac[i]);
+            ts[i]   = (a == b) ? trace.timestamps()[a] : sim_t;
+            lat0[i] = trace.latitudes()[a];
+            lat1[i] = trace.latitudes()[b];
+            lon0[i] = trace.longitudes()[a];
+            lon1[i] = trace.longitudes()[b];
+        }
+
+        // Interpolate: branch-free over contiguous arrays
+        PositionView* o = out + base;
+        for (std::size_t i = 0; i < n; ++i) {
+            o[i].timestamp = ts[i];
+            o[i].latitude  = lat0[i] + (lat1[i] - lat0[i]) * frac[i];
+            o[i].longitude = lon0[i] + (lon1[i] - lon0[i]) * frac[i];
+        }
+    }
 }
 
 // ------------------------------------------------------------------ //
 // Snapshot recording
 // ------------------------------------------------------------------ //
 
+void MobilityManager::append_extras(const Device& dev, double sim_t) {
+    const std::size_t n_extra = dev.trace.extra_names().size();
+    if (n_extra == 0) return;
+    const std::size_t offset = snap_extra_.size();
+    snap_extra_.resize(offset + n_extra);
+    // Same segment as the coordinates: the cursor makes this O(1)
+    dev.at(sim_t).view_at(sim_t, &dev.cursor, snap_extra_.data() + offset);
+}
+
 void MobilityManager::record_all(double sim_t) {
     std::lock_guard<std::mutex> lock(mutex_);
-    for (const auto& [name, trace] : traces_) {
-        snapshots_.push_back({name, trace.position_at(sim_t)});
-    }
+    const std::size_t first = snap_position_.size();
+    snap_position_.resize(first + devices_.size());
+    positions_at(handles_.data(), handles_.size(), sim_t, snap_position_.data() + first);
+    snap_device_.insert(snap_device_.end(), handles_.begin(), handles_.end());
+    for (const auto& dev : devices_) append_extras(dev, sim_t);
 }
 
 void MobilityManager::record(const std::string& device_name, double sim_t) {
-    auto it = traces_.find(device_name);
-    if (it == traces_.end()) return;
+    record(handle_of(device_name), sim_t);
+}
+
+void MobilityManager::record(DeviceHandle h, double sim_t) {
+    if (!has_trace(h)) return;
+    const Device& dev = devices_[h];
     std::lock_guard<std::mutex> lock(mutex_);
-    snapshots_.push_back({device_name, it->second.position_at(sim_t)});
+    snap_device_.push_back(h);
+    snap_position_.push_back(dev.at(sim_t).view_at(sim_t, &dev.cursor));
+    append_extras(dev, sim_t);
+}
+
+template <typename F>
+void MobilityManager::for_each_snapshot(F&& f) const {
+    // f(device, position, extras in the device's column layout)
+    std::size_t offset = 0;
+    for (std::size_t r = 0; r < snap_device_.size(); ++r) {
+        const Device& dev = devices_[snap_device_[r]];
+        f(dev, snap_position_[r], snap_extra_.data() + offset);
+        offset += dev.trace.extra_names().size();
+    }
+}
+
+std::vector<Snapshot> MobilityManager::snapshots() const {
+    std::vector<Snapshot> out;
+    out.reserve(snap_device_.size());
+    for_each_snapshot([&out](const Device& dev, const PositionView& pos, const double* extra) {
+        MobilityPosition p;
+        p.timestamp = pos.timestamp;
+        p.latitude  = pos.latitude;
+        p.longitude = pos.longitude;
+        const auto& names = dev.trace.extra_names();
+        for (std::size_t k = 0; k < names.size(); ++k)
+            if (!std::isnan(extra[k])) p.extra[names[k]] = extra[k];
+        out.push_back({dev.name, std::move(p)});
+    });
+    return out;
 }
 
 // ------------------------------------------------------------------ //
@@ -143,7 +449,7 @@ void MobilityManager::record(const std::string& device_name, double sim_t) {
 
 void MobilityManager::start_periodic_actor(simgrid::s4u::Engine& engine,
                                              double interval_s) {
-    if (traces_.empty()) return;
+    if (devices_.empty()) return;
 
     auto* host = engine.get_all_hosts().front();
     XBT_INFO("Starting MobilityRecorder actor on host '%s' (interval=%.1f s)",
@@ -151,8 +457,8 @@ void MobilityManager::start_periodic_actor(simgrid::s4u::Engine& engine,
 
     // Determine latest trace timestamp so the actor auto-terminates
     double t_end = 0.0;
-    for (const auto& [name, trace] : traces_)
-        t_end = std::max(t_end, trace.t_max());
+    for (const auto& dev : devices_)
+        t_end = std::max(t_end, dev.stream ? dev.stream->t_max() : dev.trace.t_max());
     t_end += interval_s * 2.0;  // small safety buffer
 
     // Capture by pointer (manager must outlive the simulation)
@@ -180,21 +486,22 @@ void MobilityManager::export_json(const std::string& filename) const {
 
     f << "[\n";
     bool first = true;
-    for (const auto& s : snapshots_) {
+    for_each_snapshot([&](const Device& dev, const PositionView& p, const double* extra) {
         if (!first) f << ",\n";
         first = false;
-        const auto& p = s.position;
         f << "  {"
-          << "\"device\":"    << quote(s.device_name) << ","
+          << "\"device\":"    << quote(dev.name) << ","
           << "\"timestamp\":" << std::fixed << std::setprecision(6) << p.timestamp << ","
           << "\"latitude\":"  << p.latitude  << ","
           << "\"longitude\":" << p.longitude;
-        for (const auto& [key, val] : p.extra)
-            f << ",\"" << key << "\":" << val;
+        const auto& names = dev.trace.extra_names();
+        for (std::size_t k = 0; k < names.size(); ++k)
+            if (!std::isnan(extra[k]))
+                f << ",\"" << names[k] << "\":" << extra[k];
         f << "}";
-    }
+    });
     f << "\n]\n";
-    XBT_INFO("Exported %zu snapshots to '%s'", snapshots_.size(), filename.c_str());
+    XBT_INFO("Exported %zu snapshots to '%s'", snapshot_count(), filename.c_str());
 }
 
 void MobilityManager::export_csv(const std::string& filename) const {
@@ -205,9 +512,12 @@ void MobilityManager::export_csv(const std::string& filename) const {
     std::vector<std::string> extra_keys;
     {
         std::set<std::string> seen;
-        for (const auto& s : snapshots_)
-            for (const auto& [k, _] : s.position.extra)
-                if (seen.insert(k).second) extra_keys.push_back(k);
+        for_each_snapshot([&](const Device& dev, const PositionView&, const double* extra) {
+            const auto& names = dev.trace.extra_names();
+            for (std::size_t k = 0; k < names.size(); ++k)
+                if (!std::isnan(extra[k]) && seen.insert(names[k]).second)
+                    extra_keys.push_back(names[k]);
+        });
     }
 
     // Header
@@ -216,18 +526,18 @@ void MobilityManager::export_csv(const std::string& filename) const {
     f << "\n";
 
     // Rows
-    for (const auto& s : snapshots_) {
-        const auto& p = s.position;
-        f << s.device_name << ","
+    for_each_snapshot([&](const Device& dev, const PositionView& p, const double* extra) {
+        f << dev.name << ","
           << std::fixed << std::setprecision(6)
           << p.timestamp  << "," << p.latitude  << "," << p.longitude;
         for (const auto& k : extra_keys) {
-            auto it = p.extra.find(k);
-            f << "," << (it != p.extra.end() ? it->second : 0.0);
+            int col = dev.trace.extra_index(k);
+            double val = col >= 0 ? extra[col] : 0.0;
+            f << "," << (std::isnan(val) ? 0.0 : val);
         }
         f << "\n";
-    }
-    XBT_INFO("Exported %zu snapshots to '%s'", snapshots_.size(), filename.c_str());
+    });
+    XBT_INFO("Exported %zu snapshots to '%s'", snapshot_count(), filename.c_str());
 }
 
 void MobilityManager::export_traces_json(const std::string& filename) const {
@@ -236,27 +546,31 @@ void MobilityManager::export_traces_json(const std::string& filename) const {
 
     f << "{\n";
     bool first_trace = true;
-    for (const auto& [name, trace] : traces_) {
+    for (const auto& dev : devices_) {
+        const MobilityTrace& trace = dev.trace;
         if (!first_trace) f << ",\n";
         first_trace = false;
-        f << "  " << quote(name) << ": [\n";
-        bool first_wp = true;
-        for (const auto& p : trace.waypoints()) {
-            if (!first_wp) f << ",\n";
-            first_wp = false;
+        f << "  " << quote(dev.name) << ": [\n";
+        // Straight from the columns – no per-row MobilityPosition
+        const auto& names = trace.extra_names();
+        for (std::size_t i = 0; i < trace.size(); ++i) {
+            if (i > 0) f << ",\n";
             f << "    {"
-              << "\"timestamp\":" << std::fixed << std::setprecision(6) << p.timestamp << ","
-              << "\"latitude\":"  << p.latitude  << ","
-              << "\"longitude\":" << p.longitude;
-            for (const auto& [key, val] : p.extra)
-                f << ",\"" << key << "\":" << val;
+              << "\"timestamp\":" << std::fixed << std::setprecision(6) << trace.timestamps()[i] << ","
+              << "\"latitude\":"  << trace.latitudes()[i]  << ","
+              << "\"longitude\":" << trace.longitudes()[i];
+            for (std::size_t k = 0; k < names.size(); ++k) {
+                double val = trace.extra_column(k)[i];
+                if (!std::isnan(val))
+                    f << ",\"" << names[k] << "\":" << val;
+            }
             f << "}";
         }
         f << "\n  ]";
     }
     f << "\n}\n";
     XBT_INFO("Exported raw traces for %zu devices to '%s'",
-             traces_.size(), filename.c_str());
+             devices_.size(), filename.c_str());
 }
 
 } // namespace enigma::mobility
@@ -6,10 +6,18 @@
 #include "mobility/MobilityTrace.hpp"
 
 #include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <limits>
+#include <map>
+#include <numeric>
 #include <set>
 #include <sstream>
 #include <stdexcept>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace enigma::mobility {
@@ -22,6 +30,15 @@ static double lerp_d(double a, double b, double t) noexcept {
     return a + (b - a) * t;
 }
 
+static constexpr double MISSING = std::numeric_limits<double>::quiet_NaN();
+
+/// Reorder @p v so that v[i] = old v[order[i]].
+static void permute(std::vector<double>& v, const std::vector<std::size_t>& order) {
+    std::vector<double> out(v.size());
+    for (std::size_t i = 0; i < order.size(); ++i) out[i] = v[order[i]];
+    v.swap(out);
+}
+
 /// Lowercase + trim a string token.
 static std::string norm(std::string s) {
     // trim leading/trailing whitespace
@@ -33,145 +50,589 @@ static std::string norm(std::string s) {
     return s;
 }
 
-// ------------------------------------------------------------------ //
-// MobilityTrace
-// ------------------------------------------------------------------ //
-
-std::string MobilityTrace::stem(const std::string& path) {
-    auto slash = path.find_last_of("/\\");
-    std::string filename = (slash == std::string::npos) ? path : path.substr(slash + 1);
-    auto dot = filename.rfind('.');
-    return (dot == std::string::npos) ? filename : filename.substr(0, dot);
+/// End of the line starting at @p p (the '\n' or @p end).
+static const char* next_line(const char* p, const char* end) noexcept {
+    const void* nl = std::memchr(p, '\n', static_cast<std::size_t>(end - p));
+    return nl ? static_cast<const char*>(nl) : end;
 }
 
-MobilityTrace::MobilityTrace(const std::string& csv_path)
-    : device_name_(stem(csv_path)), csv_path_(csv_path) {
-
-    std::ifstream f(csv_path);
-    if (!f.is_open())
-        throw std::runtime_error("MobilityTrace: cannot open '" + csv_path + "'");
+/// Parse a double from [first, last) like std::stod: leading blanks and a
+/// '+' are skipped, trailing characters ignored.  False if there is no number.
+static bool parse_double(const char* first, const char* last, double& out) noexcept {
+    while (first < last && (*first == ' ' || *first == '\t')) ++first;
+    if (first < last && *first == '+') ++first;
+    return std::from_chars(first, last, out).ec == std::errc();
+}
 
-    std::string line;
-    if (!std::getline(f, line))
-        throw std::runtime_error("MobilityTrace: empty file '" + csv_path + "'");
+/// [first, last) without leading/trailing blanks.
+static std::string_view trim(const char* first, const char* last) noexcept {
+    while (first < last && (*first == ' ' || *first == '\t')) ++first;
+    while (last > first && (last[-1] == ' ' || last[-1] == '\t')) --last;
+    return std::string_view(first, static_cast<std::size_t>(last - first));
+}
 
-    // ------------------------------------------------------------------
-    // Parse header – find index for the three required columns and
-    // collect "extra" (canonical-name, raw-index) pairs for all others.
-    // ------------------------------------------------------------------
+MobilityTrace::CsvLayout MobilityTrace::parse_header(const std::string& line,
+                                                     const std::string& path,
+                                                     bool device_column) {
     // Accepted aliases
     static const std::set<std::string> TS_ALIASES  = {"timestamp","time","t","ts","time_s","sim_time"};
     static const std::set<std::string> LAT_ALIASES = {"latitude","lat","lat_deg"};
     static const std::set<std::string> LON_ALIASES = {"longitude","lon","lng","lon_deg","long"};
+    static const std::set<std::string> DEV_ALIASES = {"device","device_id","host","host_id","node",
+                                                      "node_id","vehicle","vehicle_id","id"};
 
-    int c_ts = -1, c_lat = -1, c_lon = -1;
-    // extra: (canonical_name, column_index)
-    std::vector<std::pair<std::string, int>> extra_cols;
+    int c_ts = -1, c_lat = -1, c_lon = -1, c_dev = -1;
+    // extra: canonical_name -> column_index (sorted by name, last duplicate wins)
+    std::map<std::string, int> extra_cols;
 
+    int idx = 0;
     {
         std::istringstream ss(line);
         std::string tok;
-        int idx = 0;
         while (std::getline(ss, tok, ',')) {
             std::string n = norm(tok);
             if (c_ts  == -1 && TS_ALIASES .count(n)) { c_ts  = idx; }
             else if (c_lat == -1 && LAT_ALIASES.count(n)) { c_lat = idx; }
             else if (c_lon == -1 && LON_ALIASES.count(n)) { c_lon = idx; }
-            else { extra_cols.push_back({n, idx}); }
+            else if (device_column && c_dev == -1 && DEV_ALIASES.count(n)) { c_dev = idx; }
+            else { extra_cols[n] = idx; }
             ++idx;
         }
     }
 
     if (c_ts < 0 || c_lat < 0 || c_lon < 0)
         throw std::runtime_error(
-            "MobilityTrace: CSV '" + csv_path +
+            "MobilityTrace: CSV '" + path +
             "' must have timestamp, latitude and longitude columns "
             "(checked aliases: time/t/ts, lat, lon/lng)");
+    if (device_column && c_dev < 0)
+        throw std::runtime_error(
+            "MobilityTrace: CSV '" + path +
+            "' must have a device column (checked aliases: device/device_id/host/node/vehicle_id/id)");
+
+    CsvLayout layout;
+    layout.roles.assign(static_cast<std::size_t>(idx), CsvLayout::IGNORE);
+    layout.roles[c_ts]  = CsvLayout::TS;
+    layout.roles[c_lat] = CsvLayout::LAT;
+    layout.roles[c_lon] = CsvLayout::LON;
+    if (c_dev >= 0) layout.roles[c_dev] = CsvLayout::DEVICE;
+    for (const auto& [name, cidx] : extra_cols) {
+        layout.roles[cidx] = static_cast<int>(layout.extra_names.size());
+        layout.extra_names.push_back(name);
+    }
+    return layout;
+}
+
+bool MobilityTrace::parse_row(const char* first, const char* last, const CsvLayout& layout,
+                              double& ts, double& lat, double& lon, double* extra,
+                              std::string_view* device) noexcept {
+    bool has_ts = false, has_lat = false, has_lon = false;
+    std::fill(extra, extra + layout.extra_names.size(), MISSING);
+
+    const std::size_t n_cols = layout.roles.size();
+    for (std::size_t col = 0; col < n_cols; ++col) {
+        const void* comma = std::memchr(first, ',', static_cast<std::size_t>(last - first));
+        const char* field_end = comma ? static_cast<const char*>(comma) : last;
+
+        const int role = layout.roles[col];
+        if (role == CsvLayout::TS)        has_ts  = parse_double(first, field_end, ts);
+        else if (role == CsvLayout::LAT)  has_lat = parse_double(first, field_end, lat);
+        else if (role == CsvLayout::LON)  has_lon = parse_double(first, field_end, lon);
+        else if (role == CsvLayout::DEVICE && device) *device = trim(first, field_end);
+        else if (role >= 0 && !parse_double(first, field_end, extra[role]))
+            extra[role] = MISSING;  // non-numeric extra column – skip this field
+
+        if (!comma) break;
+        first = field_end + 1;
+    }
+    return has_ts && has_lat && has_lon;
+}
+
+void MobilityTrace::Columns::push(double t, double la, double lo, const double* extras) {
+    ts.push_back(t);
+    lat.push_back(la);
+    lon.push_back(lo);
+    for (std::size_t k = 0; k < extra.size(); ++k) extra[k].push_back(extras[k]);
+}
+
+/// Keeps the rows of a TraceWindow plus the nearest row beyond each edge.
+/// Rows may come in any order.
+class MobilityTrace::WindowFilter {
+public:
+    WindowFilter(const TraceWindow& window, std::size_t n_extra)
+        : lo_(window.lo()), hi_(window.hi()), n_extra_(n_extra) {}
+
+    void add(Columns& cols, double ts, double lat, double lon, const double* extra) {
+        if (ts >= lo_ && ts <= hi_) {
+            cols.push(ts, lat, lon, extra);
+        } else if (ts < lo_) {
+            // Latest row before the window (the last of equal timestamps, as
+            // the stable sort would order them)
+            if (below_.empty() || ts >= below_[0]) keep(below_, ts, lat, lon, extra);
+        } else if (above_.empty() || ts < above_[0]) {
+            keep(above_, ts, lat, lon, extra);
+        }
+    }
+
+    /// Append the edge rows kept aside.
+    void finish(Columns& cols) {
+        for (auto* row : {&below_, &above_})
+            if (!row->empty()) cols.push((*row)[0], (*row)[1], (*row)[2], row->data() + 3);
+    }
+
+private:
+    void keep(std::vector<double>& row, double ts, double lat, double lon, const double* extra) {
+        row.assign({ts, lat, lon});
+        row.insert(row.end(), extra, extra + n_extra_);
+    }
+
+    double              lo_, hi_;
+    std::size_t         n_extra_;
+    std::vector<double> below_, above_;  ///< ts, lat, lon, extras; empty if none
+};
+
+// ------------------------------------------------------------------ //
+// MobilityTrace
+// ------------------------------------------------------------------ //
+
+std::string MobilityTrace::stem(const std::string& path) {
+    auto slash = path.find_last_of("/\\");
+    std::string filename = (slash == std::string::npos) ? path : path.substr(slash + 1);
+    auto dot = filename.rfind('.');
+    return (dot == std::string::npos) ? filename : filename.substr(0, dot);
+}
+
+MobilityTrace::MobilityTrace(const std::string& csv_path, const TraceWindow& window)
+    : device_name_(stem(csv_path)), csv_path_(csv_path) {
+
+    // Whole file in one buffer; rows are parsed in place
+    std::ifstream f(csv_path, std::ios::binary);
+    if (!f.is_open())
+        throw std::runtime_error("MobilityTrace: cannot open '" + csv_path + "'");
+    std::string buf;
+    f.seekg(0, std::ios::end);
+    buf.resize(static_cast<std::size_t>(f.tellg()));
+    f.seekg(0, std::ios::beg);
+    f.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+    if (buf.empty())
+        throw std::runtime_error("MobilityTrace: empty file '" + csv_path + "'");
+
+    const char* p   = buf.data();
+    const char* end = p + buf.size();
+    const char* eol = next_line(p, end);
+
+    const CsvLayout layout = parse_header(std::string(p, eol), csv_path);
+    Columns cols;
+    cols.extra_names = layout.extra_names;
+    cols.extra.resize(cols.extra_names.size());
+
+    // Every line but the header is at most one row
+    const auto rows = static_cast<std::size_t>(std::count(eol, end, '\n'));
+    cols.ts.reserve(rows);
+    cols.lat.reserve(rows);
+    cols.lon.reserve(rows);
+    for (auto& col : cols.extra) col.reserve(rows);
 
     // ------------------------------------------------------------------
     // Parse data rows
     // ------------------------------------------------------------------
-    while (std::getline(f, line)) {
-        if (line.empty() || line[0] == '#') continue;
-
-        // Split into token vector
-        std::vector<std::string> fields;
-        {
-            std::istringstream ss(line);
-            std::string tok;
-            while (std::getline(ss, tok, ','))
-                fields.push_back(tok);
+    std::vector<double> extra(cols.extra_names.size());
+    WindowFilter in_window(window, extra.size());
+    for (p = eol; p < end; p = eol) {
+        const char* first = p < end && *p == '\n' ? p + 1 : p;
+        eol = next_line(first, end);
+        const char* last = (eol > first && eol[-1] == '\r') ? eol - 1 : eol;
+        if (first == last || *first == '#') continue;
+
+        double ts, lat, lon;
+        if (!parse_row(first, last, layout, ts, lat, lon, extra.data())) {
+            ++malformed_rows_;  // bad timestamp/lat/lon
+            continue;
         }
+        in_window.add(cols, ts, lat, lon, extra.data());
+    }
+    in_window.finish(cols);
+
+    if (cols.ts.empty())
+        throw std::runtime_error("MobilityTrace: no valid rows in '" + csv_path + "'");
+
+    adopt(std::move(cols));
+}
+
+namespace {
+
+/// Lines of a stream, read in fixed-size chunks.  A line longer than a
+/// chunk grows the buffer.
+class ChunkedLines {
+public:
+    /// @p start: position of @p in, so offset() is a file offset.
+    ChunkedLines(std::istream& in, std::size_t chunk, std::uint64_t start = 0)
+        : in_(in), buf_(chunk, '\0'), base_(start) {}
 
-        int max_req = std::max({c_ts, c_lat, c_lon});
-        if (static_cast<int>(fields.size()) <= max_req) continue; // malformed
-
-        try {
-            MobilityPosition p;
-            p.timestamp  = std::stod(fields[c_ts]);
-            p.latitude   = std::stod(fields[c_lat]);
-            p.longitude  = std::stod(fields[c_lon]);
-            for (const auto& [name, cidx] : extra_cols) {
-                if (cidx < static_cast<int>(fields.size())) {
-                    const std::string& val = fields[cidx];
-                    if (!val.empty()) {
-                        try { p.extra[name] = std::stod(val); }
-                        catch (...) { /* non-numeric extra column – skip this field */ }
-                    }
-                }
+    /// Offset of the first byte not returned yet.
+    std::uint64_t offset() const noexcept { return base_ + pos_; }
+
+    /// Next line without its '\n' / "\r\n"; false at end of stream.
+    bool next(const char*& first, const char*& last) {
+        for (;;) {
+            const char* p = buf_.data();
+            if (const void* nl = std::memchr(p + pos_, '\n', end_ - pos_)) {
+                first = p + pos_;
+                last  = static_cast<const char*>(nl);
+                pos_  = static_cast<std::size_t>(last - p) + 1;
+                break;
+            }
+            if (eof_) {
+                if (pos_ == end_) return false;
+                first = p + pos_;
+                last  = p + end_;
+                pos_  = end_;
+                break;
             }
-            waypoints_.push_back(std::move(p));
-        } catch (...) {
-            continue; // skip malformed rows (bad timestamp/lat/lon)
+            refill();
         }
+        if (last > first && last[-1] == '\r') --last;
+        return true;
     }
 
-    if (waypoints_.empty())
-        throw std::runtime_error("MobilityTrace: no valid rows in '" + csv_path + "'");
+private:
+    void refill() {
+        // Keep the partial line, then read after it
+        std::memmove(buf_.data(), buf_.data() + pos_, end_ - pos_);
+        base_ += pos_;
+        end_ -= pos_;
+        pos_ = 0;
+        if (end_ == buf_.size()) buf_.resize(buf_.size() * 2);
+        in_.read(buf_.data() + end_, static_cast<std::streamsize>(buf_.size() - end_));
+        end_ += static_cast<std::size_t>(in_.gcount());
+        eof_ = !in_;
+    }
 
-    std::sort(waypoints_.begin(), waypoints_.end(),
-              [](const MobilityPosition& a, const MobilityPosition& b) {
-                  return a.timestamp < b.timestamp;
-              });
+    std::istream& in_;
+    std::string   buf_;
+    std::uint64_t base_;
+    std::size_t   pos_ = 0, end_ = 0;
+    bool          eof_ = false;
+};
+
+} // namespace
+
+/// Read size of the long-format loader.
+static constexpr std::size_t LONG_CSV_CHUNK = 1 << 22;
+
+std::vector<MobilityTrace> MobilityTrace::load_long_csv(const std::string& csv_path,
+                                                        const TraceWindow& window,
+                                                        std::size_t* orphan_rows) {
+    std::ifstream f(csv_path, std::ios::binary);
+    if (!f.is_open())
+        throw std::runtime_error("MobilityTrace: cannot open '" + csv_path + "'");
+
+    ChunkedLines lines(f, LONG_CSV_CHUNK);
+    const char* first;
+    const char* last;
+    if (!lines.next(first, last))
+        throw std::runtime_error("MobilityTrace: empty file '" + csv_path + "'");
+    const CsvLayout layout = parse_header(std::string(first, last), csv_path, true);
+
+    struct Group {
+        Columns      cols;
+        WindowFilter in_window;
+        std::size_t  malformed = 0;
+    };
+    std::vector<Group> groups;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, std::size_t> group_of;
+    std::size_t orphans = 0;
+
+    // Rows of a device are usually contiguous: the previous group is
+    // checked before the hash lookup
+    std::size_t current = 0;
+    std::vector<double> extra(layout.extra_names.size());
+    while (lines.next(first, last)) {
+        if (first == last || *first == '#') continue;
+
+        double ts, lat, lon;
+        std::string_view device;
+        const bool ok = parse_row(first, last, layout, ts, lat, lon, extra.data(), &device);
+        if (device.empty()) {
+            ++orphans;
+            continue;
+        }
+        if (groups.empty() || names[current] != device) {
+            auto [it, added] = group_of.emplace(std::string(device), groups.size());
+            if (added) {
+                names.emplace_back(device);
+                groups.push_back(Group{{}, WindowFilter(window, extra.size())});
+                groups.back().cols.extra.resize(extra.size());
+            }
+            current = it->second;
+        }
+
+        Group& g = groups[current];
+        if (!ok) {
+            ++g.malformed;  // bad timestamp/lat/lon
+            continue;
+        }
+        g.in_window.add(g.cols, ts, lat, lon, extra.data());
+    }
+    if (f.bad())
+        throw std::runtime_error("MobilityTrace: read error in '" + csv_path + "'");
+
+    std::vector<std::size_t> order(groups.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&names](std::size_t a, std::size_t b) { return names[a] < names[b]; });
+
+    std::vector<MobilityTrace> traces;
+    traces.reserve(groups.size());
+    for (std::size_t i : order) {
+        Group& g = groups[i];
+        g.in_window.finish(g.cols);
+        if (g.cols.ts.empty()) {
+            orphans += g.malformed;  // a device without a single valid row
+            continue;
+        }
+        MobilityTrace trace;
+        trace.device_name_    = std::move(names[i]);
+        trace.csv_path_       = csv_path;
+        trace.malformed_rows_ = g.malformed;
+        g.cols.extra_names    = layout.extra_names;
+        trace.adopt(std::move(g.cols));
+        traces.push_back(std::move(trace));
+    }
+    if (orphan_rows) *orphan_rows = orphans;
+    return traces;
+}
+
+/// Read size of the streaming loader (per page-in).
+static constexpr std::size_t STREAM_CHUNK = 1 << 16;
+
+std::uint64_t MobilityTrace::read_span(const std::string& path, const CsvLayout& layout,
+                                       std::uint64_t offset, double from, double span,
+                                       double hi, Columns& keep, std::size_t& malformed,
+                                       bool& at_end) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open())
+        throw std::runtime_error("MobilityTrace: cannot open '" + path + "'");
+    f.seekg(static_cast<std::streamoff>(offset));
+    ChunkedLines lines(f, STREAM_CHUNK, offset);
+
+    auto clear = [&keep]() {
+        keep.ts.clear();
+        keep.lat.clear();
+        keep.lon.clear();
+        for (auto& col : keep.extra) col.clear();
+    };
+
+    const char* first;
+    const char* last;
+    std::vector<double> extra(layout.extra_names.size());
+    bool span_full = false;
+    for (std::uint64_t row_start = lines.offset(); lines.next(first, last);
+         row_start = lines.offset()) {
+        if (first == last || *first == '#') continue;
+
+        double ts, lat, lon;
+        if (!parse_row(first, last, layout, ts, lat, lon, extra.data())) {
+            ++malformed;  // bad timestamp/lat/lon
+            continue;
+        }
+        // Once full, the span ends before the first row past its last
+        // timestamp; that row is read again by the next call
+        if (span_full && ts > keep.ts.back()) return row_start;
+        if (!keep.ts.empty() && ts < keep.ts.back())
+            throw std::runtime_error("MobilityTrace: rows of '" + path +
+                                     "' are not in time order (required for streaming)");
+
+        // Rows up to `from` are passed over; the last one starts the span
+        if (ts <= from) clear();
+        keep.push(ts, lat, lon, extra.data());
+
+        // The span ends with the first row past the window, or with the
+        // first row `span` seconds past its start and any rows sharing its
+        // timestamp (the whole-trace lookup takes the last of those)
+        if (ts > hi) {
+            at_end = true;
+            return lines.offset();
+        }
+        if (ts >= std::max(from, keep.ts.front()) + span) span_full = true;
+    }
+    at_end = true;
+    return lines.offset();
+}
+
+TraceColumn MobilityTrace::own(std::vector<double>&& values) {
+    // Moving a vector keeps its buffer, so the view stays valid when the
+    // trace (and owned_) is moved
+    owned_.push_back(std::move(values));
+    return TraceColumn(owned_.back().data(), owned_.back().size());
+}
+
+void MobilityTrace::adopt(Columns&& cols, bool keep_empty_extras) {
+    // Drop extra columns without a single numeric value (e.g. stop_name)
+    for (std::size_t k = keep_empty_extras ? 0 : cols.extra_names.size(); k-- > 0;) {
+        const auto& col = cols.extra[k];
+        if (std::all_of(col.begin(), col.end(), [](double v) { return std::isnan(v); })) {
+            cols.extra_names.erase(cols.extra_names.begin() + k);
+            cols.extra.erase(cols.extra.begin() + k);
+        }
+    }
+
+    // Sort all columns by timestamp
+    if (!std::is_sorted(cols.ts.begin(), cols.ts.end())) {
+        std::vector<std::size_t> order(cols.ts.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&cols](std::size_t a, std::size_t b) {
+            return cols.ts[a] < cols.ts[b];
+        });
+        permute(cols.ts, order);
+        permute(cols.lat, order);
+        permute(cols.lon, order);
+        for (auto& col : cols.extra) permute(col, order);
+    }
+
+    owned_.reserve(owned_.size() + 3 + cols.extra.size());
+    timestamps_ = own(std::move(cols.ts));
+    latitudes_  = own(std::move(cols.lat));
+    longitudes_ = own(std::move(cols.lon));
+    extra_names_ = std::move(cols.extra_names);
+    extra_values_.clear();
+    for (auto& col : cols.extra) extra_values_.push_back(own(std::move(col)));
+}
+
+void MobilityTrace::clip(const TraceWindow& window) noexcept {
+    if (timestamps_.empty()) return;
+    const double* ts = timestamps_.data();
+    // Same rows as WindowFilter: [lo, hi] plus the nearest row beyond each edge
+    std::size_t a = static_cast<std::size_t>(
+        std::lower_bound(ts, ts + size(), window.lo()) - ts);
+    std::size_t b = static_cast<std::size_t>(
+        std::upper_bound(ts, ts + size(), window.hi()) - ts);
+    a = a > 0 ? a - 1 : 0;
+    b = std::min(b + 1, size());
+
+    auto narrow = [a, b](TraceColumn& col) { col = TraceColumn(col.data() + a, b - a); };
+    narrow(timestamps_);
+    narrow(latitudes_);
+    narrow(longitudes_);
+    for (auto& col : extra_values_) narrow(col);
 }
 
-MobilityPosition MobilityTrace::lerp(const MobilityPosition& a,
-                                      const MobilityPosition& b,
-                                      double t) noexcept {
+int MobilityTrace::extra_index(const std::string& name) const noexcept {
+    auto it = std::lower_bound(extra_names_.begin(), extra_names_.end(), name);
+    if (it == extra_names_.end() || *it != name) return -1;
+    return static_cast<int>(it - extra_names_.begin());
+}
+
+MobilityPosition MobilityTrace::waypoint(std::size_t i) const {
+    if (i >= size()) throw std::out_of_range("MobilityTrace::waypoint: index out of range");
     MobilityPosition p;
-    p.timestamp  = lerp_d(a.timestamp, b.timestamp, t);
-    p.latitude   = lerp_d(a.latitude,  b.latitude,  t);
-    p.longitude  = lerp_d(a.longitude, b.longitude, t);
+    p.timestamp = timestamps_[i];
+    p.latitude  = latitudes_[i];
+    p.longitude = longitudes_[i];
+    for (std::size_t k = 0; k < extra_names_.size(); ++k) {
+        double v = extra_values_[k][i];
+        if (!std::isnan(v)) p.extra[extra_names_[k]] = v;
+    }
+    return p;
+}
+
+std::vector<MobilityPosition> MobilityTrace::waypoints() const {
+    std::vector<MobilityPosition> out;
+    out.reserve(size());
+    for (std::size_t i = 0; i < size(); ++i) out.push_back(waypoint(i));
+    return out;
+}
+
+/// Segments a cursor may step forward before falling back to binary search.
+static constexpr std::size_t CURSOR_MAX_STEPS = 8;
 
-    // Interpolate all extra keys that appear in either waypoint
-    for (const auto& [key, va] : a.extra) {
-        double vb = 0.0;
-        auto it = b.extra.find(key);
-        if (it != b.extra.end()) vb = it->second;
-        p.extra[key] = lerp_d(va, vb, t);
+std::size_t MobilityTrace::segment_of(double sim_t, TraceCursor* cursor) const noexcept {
+    // Requires t_min < sim_t < t_max; returns a with ts[a] <= sim_t < ts[a + 1]
+    const std::size_t last = timestamps_.size() - 1;
+    if (cursor && cursor->segment < last && timestamps_[cursor->segment] <= sim_t) {
+        std::size_t a = cursor->segment;
+        for (std::size_t step = 0; step < CURSOR_MAX_STEPS; ++step) {
+            if (sim_t < timestamps_[a + 1]) {
+                cursor->segment = a;
+                return a;
+            }
+            ++a;
+        }
     }
-    for (const auto& [key, vb] : b.extra) {
-        if (p.extra.find(key) == p.extra.end())
-            p.extra[key] = lerp_d(0.0, vb, t);
+
+    auto it = std::upper_bound(timestamps_.begin(), timestamps_.end(), sim_t);
+    std::size_t a = static_cast<std::size_t>(it - timestamps_.begin()) - 1;
+    if (cursor) cursor->segment = a;
+    return a;
+}
+
+void MobilityTrace::locate(double sim_t, TraceCursor* cursor,
+                           std::size_t& a, std::size_t& b, double& frac) const noexcept {
+    frac = 0.0;
+    if (sim_t <= timestamps_.front()) {
+        a = b = 0;
+    } else if (sim_t >= timestamps_.back()) {
+        a = b = size() - 1;
+    } else {
+        a = segment_of(sim_t, cursor);
+        b = a + 1;
+        frac = (sim_t - timestamps_[a]) / (timestamps_[b] - timestamps_[a]);
+    }
+}
+
+PositionView MobilityTrace::view_at(double sim_t, TraceCursor* cursor,
+                                   double* extra_out) const noexcept {
+    if (timestamps_.empty()) return {};
+
+    std::size_t a, b;
+    double frac;
+    locate(sim_t, cursor, a, b, frac);
+
+    const std::size_t n_extra = extra_values_.size();
+    if (a == b) {
+        // Clamped: the first / last waypoint as stored
+        if (extra_out) {
+            for (std::size_t k = 0; k < n_extra; ++k) extra_out[k] = extra_values_[k][a];
+        }
+        return {timestamps_[a], latitudes_[a], longitudes_[a]};
+    }
+
+    if (extra_out) {
+        // A value missing on one side counts as 0, on both sides stays NaN
+        for (std::size_t k = 0; k < n_extra; ++k) {
+            double va = extra_values_[k][a];
+            double vb = extra_values_[k][b];
+            extra_out[k] = (std::isnan(va) && std::isnan(vb))
+                ? MISSING
+                : lerp_d(std::isnan(va) ? 0.0 : va, std::isnan(vb) ? 0.0 : vb, frac);
+        }
+    }
+    return {sim_t,
+            lerp_d(latitudes_[a],  latitudes_[b],  frac),
+            lerp_d(longitudes_[a], longitudes_[b], frac)};
+}
+
+MobilityPosition MobilityTrace::interpolate(double sim_t, TraceCursor* cursor) const noexcept {
+    std::vector<double> extra(extra_names_.size());
+    PositionView v = view_at(sim_t, cursor, extra.data());
+
+    MobilityPosition p;
+    p.timestamp = v.timestamp;
+    p.latitude  = v.latitude;
+    p.longitude = v.longitude;
+    for (std::size_t k = 0; k < extra.size(); ++k) {
+        if (!std::isnan(extra[k])) p.extra[extra_names_[k]] = extra[k];
     }
     return p;
 }
 
 MobilityPosition MobilityTrace::position_at(double sim_t) const noexcept {
-    if (waypoints_.empty()) return {};
-    if (sim_t <= waypoints_.front().timestamp) return waypoints_.front();
-    if (sim_t >= waypoints_.back().timestamp)  return waypoints_.back();
-
-    auto it = std::upper_bound(waypoints_.begin(), waypoints_.end(), sim_t,
-                               [](double t, const MobilityPosition& p) {
-                                   return t < p.timestamp;
-                               });
-    const MobilityPosition& b = *it;
-    const MobilityPosition& a = *(it - 1);
-    double frac = (sim_t - a.timestamp) / (b.timestamp - a.timestamp);
-    MobilityPosition p = lerp(a, b, frac);
-    p.timestamp = sim_t;
-    return p;
+    return interpolate(sim_t, nullptr);
+}
+
+MobilityPosition MobilityTrace::position_at(double sim_t, TraceCursor& cursor) const noexcept {
+    return interpolate(sim_t, &cursor);
 }
 
 } // namespace enigma::mobility
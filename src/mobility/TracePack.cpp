@@ -0,0 +1,359 @@
+/**
+ * @file TracePack.cpp
+ * @brief Implementation of TracePack.
+ */
+
+#include "mobility/TracePack.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace enigma::mobility {
+
+// ------------------------------------------------------------------ //
+// On-disk format
+// ------------------------------------------------------------------ //
+
+static constexpr char          MAGIC[8]   = {'E', 'N', 'I', 'G', 'M', 'A', 'T', 'P'};
+static constexpr std::uint32_t VERSION    = 1;
+static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;  ///< Reads differently on the other endianness
+
+/// BlockHeader::flags
+static constexpr std::uint32_t TS_DELTA     = 1u;  ///< Timestamps as int32 tick deltas
+static constexpr std::uint32_t FLOAT_COORDS = 2u;  ///< Latitude/longitude as float
+static constexpr std::uint32_t FLOAT_EXTRAS = 4u;  ///< Extra columns as float
+
+struct FileHeader {
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t device_count;
+    std::uint64_t index_offset;
+};
+
+struct IndexEntry {
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+struct BlockHeader {
+    std::uint64_t rows;
+    std::uint32_t extra_count;
+    std::uint32_t flags;
+    double        ts_origin;
+    double        ts_resolution;
+    std::uint32_t name_bytes;
+    std::uint32_t extra_name_bytes;
+};
+
+static_assert(sizeof(FileHeader)  == 32, "FileHeader must be packed to 32 bytes");
+static_assert(sizeof(IndexEntry)  == 16, "IndexEntry must be packed to 16 bytes");
+static_assert(sizeof(BlockHeader) == 40, "BlockHeader must be packed to 40 bytes");
+
+static std::size_t pad8(std::size_t n) noexcept { return (n + 7) & ~std::size_t{7}; }
+
+// ------------------------------------------------------------------ //
+// Writing
+// ------------------------------------------------------------------ //
+
+namespace {
+
+/// Sequential writer that keeps every section 8-byte aligned.
+class PackWriter {
+public:
+    explicit PackWriter(const std::string& path) : path_(path), f_(path, std::ios::binary) {
+        if (!f_) throw std::runtime_error("TracePack: cannot open '" + path + "' for writing");
+    }
+
+    std::uint64_t offset() const noexcept { return offset_; }
+
+    void put(const void* data, std::size_t bytes) {
+        f_.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+        offset_ += bytes;
+    }
+
+    void align() {
+        static const char zeros[8] = {};
+        put(zeros, pad8(offset_) - offset_);
+    }
+
+    template <typename T>
+    void column(TraceColumn values) {
+        for (double v : values) {
+            T out = static_cast<T>(v);
+            put(&out, sizeof(out));
+        }
+        align();
+    }
+
+    void patch_header(const FileHeader& header) {
+        f_.seekp(0);
+        f_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        f_.flush();
+        if (!f_) throw std::runtime_error("TracePack: write to '" + path_ + "' failed");
+    }
+
+private:
+    std::string   path_;
+    std::ofstream f_;
+    std::uint64_t offset_ = 0;
+};
+
+/// Tick counts of @p ts at @p resolution, if every timestamp round-trips
+/// exactly and every delta fits an int32.
+bool delta_encode(TraceColumn ts, double resolution, std::vector<std::int32_t>& deltas) {
+    const double origin = ts.front();
+    long long prev = 0;
+    deltas.clear();
+    for (double t : ts) {
+        const long long ticks = std::llround((t - origin) / resolution);
+        if (origin + resolution * static_cast<double>(ticks) != t) return false;
+        const long long delta = ticks - prev;
+        if (delta < 0 || delta > std::numeric_limits<std::int32_t>::max()) return false;
+        deltas.push_back(static_cast<std::int32_t>(delta));
+        prev = ticks;
+    }
+    return true;
+}
+
+} // namespace
+
+void TracePack::write(const std::string& path,
+                      const std::vector<const MobilityTrace*>& traces,
+                      const TracePackOptions& options) {
+    PackWriter out(path);
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version      = VERSION;
+    header.byte_order   = BYTE_ORDER_MARK;
+    header.device_count = traces.size();
+    out.put(&header, sizeof(header));  // patched once the index offset is known
+
+    std::vector<IndexEntry> index;
+    std::vector<std::int32_t> deltas;
+    for (const MobilityTrace* trace : traces) {
+        const std::uint64_t start = out.offset();
+
+        std::string extra_names;
+        for (const auto& name : trace->extra_names()) {
+            if (!extra_names.empty()) extra_names += '\n';
+            extra_names += name;
+        }
+
+        BlockHeader block{};
+        block.rows             = trace->size();
+        block.extra_count      = static_cast<std::uint32_t>(trace->extra_names().size());
+        block.ts_origin        = trace->t_min();
+        block.name_bytes       = static_cast<std::uint32_t>(trace->device_name().size());
+        block.extra_name_bytes = static_cast<std::uint32_t>(extra_names.size());
+        if (options.ts_resolution > 0 && trace->size() > 0 &&
+            delta_encode(trace->timestamps(), options.ts_resolution, deltas)) {
+            block.flags |= TS_DELTA;
+            block.ts_resolution = options.ts_resolution;
+        }
+        if (options.float_coords) block.flags |= FLOAT_COORDS;
+        if (options.float_extras) block.flags |= FLOAT_EXTRAS;
+
+        out.put(&block, sizeof(block));
+        out.put(trace->device_name().data(), block.name_bytes);
+        out.put(extra_names.data(), block.extra_name_bytes);
+        out.align();
+
+        if (block.flags & TS_DELTA) {
+            out.put(deltas.data(), deltas.size() * sizeof(std::int32_t));
+            out.align();
+        } else {
+            out.column<double>(trace->timestamps());
+        }
+        if (options.float_coords) {
+            out.column<float>(trace->latitudes());
+            out.column<float>(trace->longitudes());
+        } else {
+            out.column<double>(trace->latitudes());
+            out.column<double>(trace->longitudes());
+        }
+        for (std::size_t k = 0; k < block.extra_count; ++k) {
+            if (options.float_extras) out.column<float>(trace->extra_column(k));
+            else                      out.column<double>(trace->extra_column(k));
+        }
+
+        index.push_back({start, out.offset() - start});
+    }
+
+    header.index_offset = out.offset();
+    out.put(index.data(), index.size() * sizeof(IndexEntry));
+    out.patch_header(header);
+}
+
+// ------------------------------------------------------------------ //
+// Reading
+// ------------------------------------------------------------------ //
+
+namespace {
+
+/// A read-only mapping of a whole file, unmapped with its last user.
+struct Mapping {
+    const char* data = nullptr;
+    std::size_t size = 0;
+
+    ~Mapping() {
+        if (data) munmap(const_cast<char*>(data), size);
+    }
+};
+
+std::shared_ptr<const Mapping> map_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("TracePack: cannot open '" + path + "'");
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+        ::close(fd);
+        throw std::runtime_error("TracePack: '" + path + "' is too small to be a pack");
+    }
+
+    void* addr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // the mapping keeps the file referenced
+    if (addr == MAP_FAILED) throw std::runtime_error("TracePack: cannot map '" + path + "'");
+
+    auto mapping = std::make_shared<Mapping>();
+    mapping->data = static_cast<const char*>(addr);
+    mapping->size = static_cast<std::size_t>(st.st_size);
+    return mapping;
+}
+
+/// Bounds-checked cursor over one device block.
+class BlockReader {
+public:
+    BlockReader(const char* base, std::size_t size, const std::string& path)
+        : base_(base), size_(size), path_(path) {}
+
+    const char* take(std::size_t bytes) {
+        if (bytes > size_ - pos_) throw std::runtime_error("TracePack: truncated block in '" + path_ + "'");
+        const char* p = base_ + pos_;
+        pos_ = std::min(size_, pad8(pos_ + bytes));
+        return p;
+    }
+
+private:
+    const char*        base_;
+    std::size_t        size_;
+    std::size_t        pos_ = 0;
+    const std::string& path_;
+};
+
+template <typename T>
+std::vector<double> widen(const char* data, std::size_t rows) {
+    std::vector<double> out(rows);
+    for (std::size_t i = 0; i < rows; ++i) {
+        T v;
+        std::memcpy(&v, data + i * sizeof(T), sizeof(T));
+        out[i] = static_cast<double>(v);
+    }
+    return out;
+}
+
+} // namespace
+
+bool TracePack::is_pack(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    char magic[sizeof(MAGIC)] = {};
+    return f.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+std::vector<MobilityTrace> TracePack::open(const std::string& path, const TraceWindow& window) {
+    auto mapping = map_file(path);
+    const char* base = mapping->data;
+    const std::size_t size = mapping->size;
+
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("TracePack: '" + path + "' is not a trace pack");
+    if (header.version != VERSION)
+        throw std::runtime_error("TracePack: '" + path + "' has unsupported version " +
+                                 std::to_string(header.version));
+    if (header.byte_order != BYTE_ORDER_MARK)
+        throw std::runtime_error("TracePack: '" + path + "' was written with another byte order");
+    if (header.index_offset > size ||
+        header.device_count > (size - header.index_offset) / sizeof(IndexEntry))
+        throw std::runtime_error("TracePack: corrupt index in '" + path + "'");
+
+    std::vector<MobilityTrace> traces;
+    traces.reserve(header.device_count);
+    for (std::uint64_t d = 0; d < header.device_count; ++d) {
+        IndexEntry entry;
+        std::memcpy(&entry, base + header.index_offset + d * sizeof(IndexEntry), sizeof(entry));
+        if (entry.offset % 8 != 0 || entry.offset > size || entry.size > size - entry.offset)
+            throw std::runtime_error("TracePack: corrupt index in '" + path + "'");
+
+        BlockReader in(base + entry.offset, entry.size, path);
+        BlockHeader block;
+        std::memcpy(&block, in.take(sizeof(block)), sizeof(block));
+        if (block.rows == 0 || block.rows > entry.size)
+            throw std::runtime_error("TracePack: corrupt block in '" + path + "'");
+        const std::size_t rows = block.rows;
+
+        MobilityTrace trace;
+        trace.csv_path_ = path;
+        trace.mapping_  = mapping;
+
+        // Names share one padded section
+        const char* names = in.take(std::size_t{block.name_bytes} + block.extra_name_bytes);
+        trace.device_name_.assign(names, block.name_bytes);
+        std::string extra(names + block.name_bytes, block.extra_name_bytes);
+        for (std::size_t k = 0, pos = 0; k < block.extra_count; ++k) {
+            if (pos > extra.size())
+                throw std::runtime_error("TracePack: corrupt block in '" + path + "'");
+            std::size_t nl = std::min(extra.find('\n', pos), extra.size());
+            trace.extra_names_.push_back(extra.substr(pos, nl - pos));
+            pos = nl + 1;
+        }
+
+        // Double columns are used in place, encoded ones decoded once
+        auto column = [&](bool as_float) -> TraceColumn {
+            if (as_float) return trace.own(widen<float>(in.take(rows * sizeof(float)), rows));
+            return TraceColumn(reinterpret_cast<const double*>(in.take(rows * sizeof(double))), rows);
+        };
+
+        if (block.flags & TS_DELTA) {
+            const char* data = in.take(rows * sizeof(std::int32_t));
+            std::vector<double> ts(rows);
+            long long ticks = 0;
+            for (std::size_t i = 0; i < rows; ++i) {
+                std::int32_t delta;
+                std::memcpy(&delta, data + i * sizeof(delta), sizeof(delta));
+                ticks += delta;
+                ts[i] = block.ts_origin + block.ts_resolution * static_cast<double>(ticks);
+            }
+            trace.timestamps_ = trace.own(std::move(ts));
+        } else {
+            trace.timestamps_ = column(false);
+        }
+        trace.latitudes_  = column(block.flags & FLOAT_COORDS);
+        trace.longitudes_ = column(block.flags & FLOAT_COORDS);
+        for (std::size_t k = 0; k < block.extra_count; ++k)
+            trace.extra_values_.push_back(column(block.flags & FLOAT_EXTRAS));
+
+        // Rows outside the window are never touched (nor paged in)
+        trace.clip(window);
+        if (!std::is_sorted(trace.timestamps_.begin(), trace.timestamps_.end()))
+            throw std::runtime_error("TracePack: unsorted timestamps in '" + path + "'");
+
+        traces.push_back(std::move(trace));
+    }
+    return traces;
+}
+
+} // namespace enigma::mobility
@@ -0,0 +1,115 @@
+/**
+ * @file TraceStream.cpp
+ * @brief Implementation of TraceStream.
+ */
+
+#include "mobility/TraceStream.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace enigma::mobility {
+
+/// Bytes read from the end of the file to find the last row.
+static constexpr std::size_t TAIL_BYTES = 1 << 16;
+
+TraceStream::TraceStream(const std::string& csv_path, double chunk_s, const TraceWindow& window)
+    : path_(csv_path), chunk_s_(chunk_s), window_(window),
+      t_max_(-std::numeric_limits<double>::infinity()) {
+    if (!(chunk_s_ > 0))
+        throw std::invalid_argument("TraceStream: chunk length must be positive");
+
+    std::ifstream f(csv_path, std::ios::binary);
+    if (!f.is_open())
+        throw std::runtime_error("MobilityTrace: cannot open '" + csv_path + "'");
+    std::string header;
+    if (!std::getline(f, header))
+        throw std::runtime_error("MobilityTrace: empty file '" + csv_path + "'");
+    auto layout = std::make_unique<MobilityTrace::CsvLayout>(
+        MobilityTrace::parse_header(header, csv_path));
+    offset_ = static_cast<std::uint64_t>(f.tellg());
+
+    // The last valid row gives t_max without reading the whole trace
+    f.seekg(0, std::ios::end);
+    const auto size = static_cast<std::uint64_t>(f.tellg());
+    const std::uint64_t from = std::max(offset_, size > TAIL_BYTES ? size - TAIL_BYTES : 0);
+    std::string tail(static_cast<std::size_t>(size - from), '\0');
+    f.seekg(static_cast<std::streamoff>(from));
+    f.read(tail.data(), static_cast<std::streamsize>(tail.size()));
+
+    std::vector<double> extra(layout->extra_names.size());
+    for (std::size_t end = tail.size(); end > 0;) {
+        std::size_t begin = tail.rfind('\n', end - 1);
+        begin = (begin == std::string::npos) ? 0 : begin + 1;
+        if (begin == 0 && from > offset_) break;  // line cut by the tail read
+        const char* first = tail.data() + begin;
+        const char* last  = tail.data() + end;
+        if (last > first && last[-1] == '\r') --last;
+
+        double ts, lat, lon;
+        if (first < last && *first != '#' &&
+            MobilityTrace::parse_row(first, last, *layout, ts, lat, lon, extra.data())) {
+            t_max_ = ts;
+            break;
+        }
+        end = begin > 0 ? begin - 1 : 0;
+    }
+    t_max_ = std::min(t_max_, window_.hi());
+    layout_ = std::move(layout);
+}
+
+TraceStream::~TraceStream() = default;
+
+MobilityTrace TraceStream::first() {
+    MobilityTrace::Columns keep;
+    keep.extra_names = layout_->extra_names;
+    keep.extra.resize(keep.extra_names.size());
+
+    MobilityTrace chunk = read(window_.lo(), std::move(keep));
+    if (chunk.timestamps_.empty())
+        throw std::runtime_error("MobilityTrace: no valid rows in '" + path_ + "'");
+    t_max_ = std::max(t_max_, chunk.t_max());
+    return chunk;
+}
+
+bool TraceStream::page(double sim_t, MobilityTrace& resident) {
+    if (done_ || resident.timestamps_.empty() || sim_t <= resident.t_max()) return false;
+
+    // The last resident row starts the next chunk
+    MobilityTrace::Columns keep;
+    keep.extra_names = layout_->extra_names;
+    keep.extra.resize(keep.extra_names.size());
+    const std::size_t i = resident.size() - 1;
+    std::vector<double> extra(keep.extra.size());
+    for (std::size_t k = 0; k < extra.size(); ++k) extra[k] = resident.extra_values_[k][i];
+    keep.push(resident.timestamps_[i], resident.latitudes_[i], resident.longitudes_[i],
+              extra.data());
+
+    resident = read(sim_t, std::move(keep));
+    return true;
+}
+
+MobilityTrace TraceStream::read(double from, MobilityTrace::Columns&& keep) {
+    try {
+        bool at_end = false;
+        offset_ = MobilityTrace::read_span(path_, *layout_, offset_, from, chunk_s_,
+                                           window_.hi(), keep, malformed_, at_end);
+        done_ = at_end;
+    } catch (...) {
+        done_ = true;
+        throw;
+    }
+    ++chunks_;
+
+    MobilityTrace chunk;
+    chunk.device_name_    = MobilityTrace::stem(path_);
+    chunk.csv_path_       = path_;
+    chunk.malformed_rows_ = malformed_;
+    if (!keep.ts.empty()) chunk.adopt(std::move(keep), true);  // stable column layout
+    return chunk;
+}
+
+} // namespace enigma::mobility
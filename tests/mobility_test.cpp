@@ -19,7 +19,9 @@
  */
 
 #include <simgrid/s4u.hpp>
+#include <cmath>
 #include <iostream>
+#include <vector>
 
 #include "mobility/MobilityManager.hpp"
 #include "mobility/MobilityPosition.hpp"
@@ -48,12 +50,23 @@ public:
         , iterations_(iterations) {}
 
     void operator()() const {
+        // Resolve the device and its extra columns once; queries then use
+        // the handle and fill a fixed buffer
+        const DeviceHandle dev = mob_->handle_of(sg4::this_actor::get_host());
+        const MobilityTrace* trace = mob_->trace(dev);
+        std::vector<double> extra(trace ? trace->extra_names().size() : 0);
+        const int i_spd = trace ? trace->extra_index("speed")   : -1;
+        const int i_hdg = trace ? trace->extra_index("heading") : -1;
+        auto column = [&extra](int k) {
+            return (k >= 0 && !std::isnan(extra[k])) ? extra[k] : 0.0;
+        };
+
         for (int i = 0; i < iterations_; ++i) {
             double t = sg4::Engine::get_clock();
-            auto pos = mob_->position_at(host_name_, t);
+            auto pos = mob_->view_at(dev, t, extra.data());
             if (pos) {
-                double spd = pos->extra.count("speed")   ? pos->extra.at("speed")   : 0.0;
-                double hdg = pos->extra.count("heading") ? pos->extra.at("heading") : 0.0;
+                double spd = column(i_spd);
+                double hdg = column(i_hdg);
                 XBT_INFO("[%.2f s] %s → lat=%.6f lon=%.6f  spd=%.1f m/s  hdg=%.1f°",
                          t, host_name_.c_str(),
                          pos->latitude, pos->longitude, spd, hdg);
@@ -122,7 +135,7 @@ int main(int argc, char** argv) {
     auto hosts = e.get_all_hosts();
     int deployed = 0;
     for (auto* host : hosts) {
-        if (mob->has_trace(host->get_cname())) {
+        if (mob->handle_of(host) != NO_DEVICE) {
             host->add_actor("mobile_actor",
                             MobileActor(host->get_cname(), mob.get(), 1.0, 8));
             XBT_INFO("Deployed mobile actor on '%s'", host->get_cname());
@@ -154,7 +167,7 @@ int main(int argc, char** argv) {
     mob->export_traces_json(raw_json);
 
     XBT_INFO("Outputs written:");
-    XBT_INFO("  Snapshots JSON : %s  (%zu records)", json_out.c_str(), mob->snapshots().size());
+    XBT_INFO("  Snapshots JSON : %s  (%zu records)", json_out.c_str(), mob->snapshot_count());
     XBT_INFO("  Snapshots CSV  : %s", csv_out.c_str());
     XBT_INFO("  Raw traces JSON: %s", raw_json.c_str());
     XBT_INFO("Visualise with:");
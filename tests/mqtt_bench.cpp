@@ -0,0 +1,433 @@
+#include <simgrid/s4u.hpp>
+#include "comms/mqtt/MQTT.hpp"
+#include "comms/p2p/P2P.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+XBT_LOG_NEW_DEFAULT_CATEGORY(mqtt_bench, "MQTT Broker Benchmark");
+
+namespace sg4 = simgrid::s4u;
+using namespace enigma::mqtt;
+using enigma::p2p::P2PPublisher;
+using enigma::p2p::P2PSubscriber;
+
+/**
+ * @brief Benchmark parameters (set from the command line)
+ */
+struct BenchConfig {
+    std::string transport = "mqtt";  // mqtt | bridge (edge -> cloud broker) | p2p (brokerless)
+    int publishers = 10;
+    int subscribers = 1;
+    int topics = 1;
+    std::string pattern = "all";   // all | topic | shared
+    size_t message_size = 256;     // Payload bytes
+    double rate = 10.0;            // Messages/s per publisher (0 = as fast as possible)
+    int messages = 100;            // Messages per publisher
+    int qos = 0;
+    MQTTCodec codec;               // Payload compression on the publishers
+    double warmup = 1.0;           // Time for subscriptions to settle before publishing
+    double idle = 1.0;             // Subscribers stop after this long without traffic
+    std::string broker_host;       // Empty = fastest host
+    MQTTBrokerConfig broker;
+    std::string csv_file;          // Append one result row (regression tracking)
+};
+
+/**
+ * @brief Results collected by the benchmark actors
+ */
+struct BenchResults {
+    int publishers_done = 0;
+    long published = 0;
+    long delivered = 0;
+    double first_publish = -1;
+    double last_delivery = 0;
+    MQTTLatencyHistogram latency;
+};
+
+static BenchConfig CONFIG;
+static BenchResults RESULTS;
+
+static const std::string BROKER_NAME = "mqtt_broker";
+static const std::string EDGE_BROKER_NAME = "mqtt_broker_edge";
+static const std::string P2P_DOMAIN = "bench";
+
+static std::string topic_name(int index) {
+    return "bench/t" + std::to_string(index);
+}
+
+/**
+ * @brief Publishes CONFIG.messages messages at a fixed rate
+ */
+class BenchPublisher {
+    int index;
+    
+public:
+    explicit BenchPublisher(int i) : index(i) {}
+    
+    void operator()() {
+        const std::string id = "bench_pub_" + std::to_string(index);
+        if (CONFIG.transport == "p2p") {
+            P2PPublisher publisher(P2P_DOMAIN, id);
+            publisher.set_compression(CONFIG.codec);
+            run(publisher);
+        } else {
+            // Bridged runs publish on the edge broker, subscribers stay on the cloud one
+            MQTTPublisher publisher(CONFIG.transport == "bridge" ? EDGE_BROKER_NAME : BROKER_NAME, id);
+            publisher.set_compression(CONFIG.codec);
+            run(publisher);
+            publisher.wait_for_acks();
+        }
+        RESULTS.publishers_done++;
+    }
+    
+private:
+    template <typename Publisher>
+    void run(Publisher& publisher) {
+        const std::string topic = topic_name(index % CONFIG.topics);
+        const std::string payload(std::min<size_t>(CONFIG.message_size, 64), 'x');
+        
+        sg4::this_actor::sleep_for(CONFIG.warmup);
+        
+        double start = sg4::Engine::get_clock();
+        if (RESULTS.first_publish < 0 || start < RESULTS.first_publish) {
+            RESULTS.first_publish = start;
+        }
+        
+        double interval = CONFIG.rate > 0 ? 1.0 / CONFIG.rate : 0.0;
+        for (int k = 0; k < CONFIG.messages; k++) {
+            publisher.publish(topic, payload, CONFIG.message_size, CONFIG.qos);
+            RESULTS.published++;
+            
+            // Fixed schedule, so slow sends do not lower the offered rate
+            if (interval > 0) {
+                double next = start + (k + 1) * interval;
+                double now = sg4::Engine::get_clock();
+                if (next > now) {
+                    sg4::this_actor::sleep_for(next - now);
+                }
+            }
+        }
+    }
+};
+
+/**
+ * @brief Receives until all publishers are done and traffic has stopped
+ */
+class BenchSubscriber {
+    int index;
+    
+public:
+    explicit BenchSubscriber(int i) : index(i) {}
+    
+    void operator()() {
+        const std::string id = "bench_sub_" + std::to_string(index);
+        if (CONFIG.transport == "p2p") {
+            P2PSubscriber subscriber(P2P_DOMAIN, id);
+            run(subscriber);
+        } else {
+            MQTTSubscriber subscriber(BROKER_NAME, id);
+            run(subscriber);
+        }
+    }
+    
+private:
+    template <typename Subscriber>
+    void run(Subscriber& subscriber) {
+        if (CONFIG.pattern == "topic") {
+            subscriber.subscribe(topic_name(index % CONFIG.topics), CONFIG.qos);
+        } else if (CONFIG.pattern == "shared") {
+            subscriber.subscribe("$share/bench/bench/#", CONFIG.qos);
+        } else {
+            subscriber.subscribe("bench/#", CONFIG.qos);
+        }
+        
+        while (true) {
+            auto batch = subscriber.receive_batch(1000, CONFIG.idle);
+            if (batch.empty()) {
+                if (RESULTS.publishers_done == CONFIG.publishers) {
+                    break;
+                }
+                continue;
+            }
+            
+            double now = sg4::Engine::get_clock();
+            for (const auto& msg : batch) {
+                RESULTS.latency.record(now - msg->timestamp);
+                RESULTS.delivered++;
+            }
+            RESULTS.last_delivery = std::max(RESULTS.last_delivery, now);
+        }
+    }
+};
+
+/**
+ * @brief Waits for all clients, then stops the broker (if any)
+ */
+class BenchController {
+    std::vector<sg4::ActorPtr> clients;
+    
+public:
+    explicit BenchController(std::vector<sg4::ActorPtr> actors) : clients(std::move(actors)) {}
+    
+    void operator()() {
+        for (auto& actor : clients) {
+            actor->join();
+        }
+        if (CONFIG.transport != "p2p") {
+            stop_broker(BROKER_NAME);
+        }
+        if (CONFIG.transport == "bridge") {
+            stop_broker(EDGE_BROKER_NAME);
+        }
+    }
+};
+
+static long expected_deliveries() {
+    long total = static_cast<long>(CONFIG.publishers) * CONFIG.messages;
+    if (CONFIG.pattern == "shared") {
+        return CONFIG.subscribers > 0 ? total : 0;
+    }
+    if (CONFIG.pattern == "all") {
+        return total * CONFIG.subscribers;
+    }
+    
+    // "topic": each subscriber gets the messages of its topic
+    long expected = 0;
+    for (int s = 0; s < CONFIG.subscribers; s++) {
+        for (int p = 0; p < CONFIG.publishers; p++) {
+            if (p % CONFIG.topics == s % CONFIG.topics) {
+                expected += CONFIG.messages;
+            }
+        }
+    }
+    return expected;
+}
+
+static void print_usage(const char* prog) {
+    XBT_CRITICAL("Usage: %s <platform_file.xml> [options]", prog);
+    XBT_CRITICAL("Options:");
+    XBT_CRITICAL("  --transport <t>       mqtt: through the broker (default)");
+    XBT_CRITICAL("                        bridge: publishers use an edge broker bridged at QoS 2");
+    XBT_CRITICAL("                                to the broker of the subscribers");
+    XBT_CRITICAL("                        p2p: brokerless, publishers send to subscribers directly");
+    XBT_CRITICAL("  --publishers <n>      Publisher clients (default: 10)");
+    XBT_CRITICAL("  --subscribers <n>     Subscriber clients (default: 1)");
+    XBT_CRITICAL("  --topics <n>          Topics, publisher i uses topic i %% n (default: 1)");
+    XBT_CRITICAL("  --pattern <p>         all: every subscriber gets every topic (fan-in/fan-out)");
+    XBT_CRITICAL("                        topic: subscriber j gets topic j %% topics");
+    XBT_CRITICAL("                        shared: subscribers form one shared subscription");
+    XBT_CRITICAL("  --size <bytes>        Payload size (default: 256)");
+    XBT_CRITICAL("  --rate <msg/s>        Per-publisher rate, 0 = as fast as possible (default: 10)");
+    XBT_CRITICAL("  --messages <n>        Messages per publisher (default: 100)");
+    XBT_CRITICAL("  --qos <0|1|2>         Quality of Service (default: 0)");
+    XBT_CRITICAL("  --codec <name>        Payload compression: none, lz4, zstd, gzip (default: none)");
+    XBT_CRITICAL("  --broker-host <name>  Broker host (default: fastest host)");
+    XBT_CRITICAL("  --workers <n>         Broker worker actors (default: 1)");
+    XBT_CRITICAL("  --cost-per-message <flops>, --cost-per-byte <flops>");
+    XBT_CRITICAL("                        Broker service-time model (default: 0)");
+    XBT_CRITICAL("  --queue <n>           Subscriber queue capacity (default: 1000)");
+    XBT_CRITICAL("  --stats <prefix>      Export broker statistics to <prefix>_*.csv/.json");
+    XBT_CRITICAL("  --csv <file>          Append a result row to <file>");
+}
+
+int main(int argc, char* argv[]) {
+    sg4::Engine e(&argc, argv);
+    
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    e.load_platform(argv[1]);
+    
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            XBT_WARN("Ignoring option '%s' without value", arg.c_str());
+            break;
+        }
+        std::string value = argv[++i];
+        
+        if (arg == "--transport") {
+            CONFIG.transport = value;
+        } else if (arg == "--publishers") {
+            CONFIG.publishers = std::atoi(value.c_str());
+        } else if (arg == "--subscribers") {
+            CONFIG.subscribers = std::atoi(value.c_str());
+        } else if (arg == "--topics") {
+            CONFIG.topics = std::atoi(value.c_str());
+        } else if (arg == "--pattern") {
+            CONFIG.pattern = value;
+        } else if (arg == "--size") {
+            CONFIG.message_size = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--rate") {
+            CONFIG.rate = std::atof(value.c_str());
+        } else if (arg == "--messages") {
+            CONFIG.messages = std::atoi(value.c_str());
+        } else if (arg == "--qos") {
+            CONFIG.qos = std::clamp(std::atoi(value.c_str()), 0, 2);
+        } else if (arg == "--codec") {
+            try {
+                CONFIG.codec = MQTTCodec::by_name(value);
+            } catch (const std::invalid_argument& ex) {
+                XBT_CRITICAL("%s", ex.what());
+                return 1;
+            }
+        } else if (arg == "--broker-host") {
+            CONFIG.broker_host = value;
+        } else if (arg == "--workers") {
+            CONFIG.broker.service.workers = std::atoi(value.c_str());
+        } else if (arg == "--cost-per-message") {
+            CONFIG.broker.service.cost_per_message = std::atof(value.c_str());
+        } else if (arg == "--cost-per-byte") {
+            CONFIG.broker.service.cost_per_byte = std::atof(value.c_str());
+        } else if (arg == "--queue") {
+            CONFIG.broker.queue.capacity = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--stats") {
+            CONFIG.broker.stats.export_prefix = value;
+        } else if (arg == "--csv") {
+            CONFIG.csv_file = value;
+        } else {
+            XBT_WARN("Unknown option '%s'", arg.c_str());
+        }
+    }
+    
+    if (CONFIG.publishers <= 0 || CONFIG.messages <= 0 || CONFIG.topics <= 0 ||
+        CONFIG.subscribers < 0) {
+        XBT_CRITICAL("publishers, messages and topics must be > 0");
+        return 1;
+    }
+    if (CONFIG.pattern != "all" && CONFIG.pattern != "topic" && CONFIG.pattern != "shared") {
+        XBT_CRITICAL("Unknown pattern '%s'", CONFIG.pattern.c_str());
+        return 1;
+    }
+    if (CONFIG.transport != "mqtt" && CONFIG.transport != "bridge" && CONFIG.transport != "p2p") {
+        XBT_CRITICAL("Unknown transport '%s'", CONFIG.transport.c_str());
+        return 1;
+    }
+    if (CONFIG.transport == "p2p" && CONFIG.pattern == "shared") {
+        XBT_CRITICAL("Shared subscriptions need the broker (--transport mqtt)");
+        return 1;
+    }
+    
+    // Broker on the requested host, or the fastest one
+    std::vector<sg4::Host*> hosts = e.get_all_hosts();
+    sg4::Host* broker_host = nullptr;
+    if (!CONFIG.broker_host.empty()) {
+        broker_host = sg4::Host::by_name_or_null(CONFIG.broker_host);
+        if (broker_host == nullptr) {
+            XBT_CRITICAL("Unknown broker host '%s'", CONFIG.broker_host.c_str());
+            return 1;
+        }
+    } else {
+        broker_host = *std::max_element(hosts.begin(), hosts.end(),
+                                        [](sg4::Host* a, sg4::Host* b) {
+                                            return a->get_speed() < b->get_speed();
+                                        });
+    }
+    
+    // Clients are spread over the remaining hosts
+    std::vector<sg4::Host*> client_hosts;
+    for (auto* host : hosts) {
+        if (host != broker_host) client_hosts.push_back(host);
+    }
+    if (client_hosts.empty()) {
+        client_hosts.push_back(broker_host);
+    }
+    
+    XBT_INFO("=== MQTT Broker Benchmark ===");
+    if (CONFIG.transport == "p2p") {
+        XBT_INFO("Transport: brokerless P2P (host '%s' runs no broker)", broker_host->get_cname());
+    } else {
+        XBT_INFO("Broker host: '%s' (%.3e flops, %d cores)", broker_host->get_cname(),
+                 broker_host->get_speed(), broker_host->get_core_count());
+    }
+    XBT_INFO("Publishers: %d, subscribers: %d, topics: %d, pattern: %s",
+             CONFIG.publishers, CONFIG.subscribers, CONFIG.topics, CONFIG.pattern.c_str());
+    XBT_INFO("Messages: %d x %zu bytes per publisher at %.2f msg/s, QoS %d, codec %s",
+             CONFIG.messages, CONFIG.message_size, CONFIG.rate, CONFIG.qos,
+             CONFIG.codec.name.c_str());
+    
+    std::vector<sg4::ActorPtr> clients;
+    if (CONFIG.transport != "p2p") {
+        start_broker(broker_host, BROKER_NAME, CONFIG.broker);
+    }
+    if (CONFIG.transport == "bridge") {
+        // Edge broker and bridge share the first client host; the bridge
+        // outlives the warmup and the gaps between publishes
+        sg4::Host* edge_host = client_hosts.front();
+        MQTTBrokerConfig edge_config = CONFIG.broker;
+        if (!edge_config.stats.export_prefix.empty()) {
+            edge_config.stats.export_prefix += "_edge";
+        }
+        start_broker(edge_host, EDGE_BROKER_NAME, edge_config);
+        
+        auto bridge = MQTTBridgeConfig::create(EDGE_BROKER_NAME, BROKER_NAME, "bench/#");
+        bridge.idle_timeout = CONFIG.warmup + CONFIG.idle + (CONFIG.rate > 0 ? 1.0 / CONFIG.rate : 0.0);
+        clients.push_back(start_bridge(edge_host, bridge));
+        XBT_INFO("Edge broker and bridge on host '%s'", edge_host->get_cname());
+    }
+    
+    for (int j = 0; j < CONFIG.subscribers; j++) {
+        sg4::Host* host = client_hosts[client_hosts.size() - 1 - j % client_hosts.size()];
+        clients.push_back(host->add_actor("bench_subscriber", BenchSubscriber(j)));
+    }
+    for (int i = 0; i < CONFIG.publishers; i++) {
+        sg4::Host* host = client_hosts[i % client_hosts.size()];
+        clients.push_back(host->add_actor("bench_publisher", BenchPublisher(i)));
+    }
+    broker_host->add_actor("bench_controller", BenchController(clients));
+    
+    auto wall_start = std::chrono::steady_clock::now();
+    e.run();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    
+    // Report
+    double duration = RESULTS.last_delivery - std::max(RESULTS.first_publish, 0.0);
+    long expected = expected_deliveries();
+    const auto& lat = RESULTS.latency;
+    
+    XBT_INFO("=== Benchmark Results ===");
+    XBT_INFO("  Published:  %ld messages", RESULTS.published);
+    XBT_INFO("  Delivered:  %ld of %ld expected (%.1f%%)", RESULTS.delivered, expected,
+             expected > 0 ? 100.0 * RESULTS.delivered / expected : 0.0);
+    XBT_INFO("  Simulated duration: %.6f s (first publish -> last delivery)", duration);
+    if (duration > 0) {
+        XBT_INFO("  Throughput: %.2f msg/s delivered, %.2f msg/s published",
+                 RESULTS.delivered / duration, RESULTS.published / duration);
+    }
+    XBT_INFO("  Latency: mean %.6f s, p50 %.6f s, p95 %.6f s, p99 %.6f s, max %.6f s",
+             lat.mean(), lat.percentile(50), lat.percentile(95), lat.percentile(99), lat.max());
+    XBT_INFO("  Wall time: %.3f s (%.3f us per delivered message)", wall,
+             RESULTS.delivered > 0 ? 1e6 * wall / RESULTS.delivered : 0.0);
+    
+    if (!CONFIG.csv_file.empty()) {
+        bool header = !std::ifstream(CONFIG.csv_file).good();
+        std::ofstream f(CONFIG.csv_file, std::ios::app);
+        if (!f) {
+            XBT_WARN("Cannot open '%s' for writing", CONFIG.csv_file.c_str());
+        } else {
+            if (header) {
+                f << "transport,broker_host,publishers,subscribers,topics,pattern,size,rate,messages,qos,"
+                     "codec,published,delivered,duration,throughput,lat_mean,lat_p50,lat_p95,lat_p99,"
+                     "lat_max,wall_time,wall_us_per_msg\n";
+            }
+            f << CONFIG.transport << "," << broker_host->get_cname() << "," << CONFIG.publishers << ","
+              << CONFIG.subscribers << "," << CONFIG.topics << "," << CONFIG.pattern << ","
+              << CONFIG.message_size << "," << CONFIG.rate << "," << CONFIG.messages << ","
+              << CONFIG.qos << "," << CONFIG.codec.name << "," << RESULTS.published << "," << RESULTS.delivered << ","
+              << duration << "," << (duration > 0 ? RESULTS.delivered / duration : 0.0) << ","
+              << lat.mean() << "," << lat.percentile(50) << "," << lat.percentile(95) << ","
+              << lat.percentile(99) << "," << lat.max() << "," << wall << ","
+              << (RESULTS.delivered > 0 ? 1e6 * wall / RESULTS.delivered : 0.0) << "\n";
+            XBT_INFO("Results appended to '%s'", CONFIG.csv_file.c_str());
+        }
+    }
+    
+    return 0;
+}
@@ -78,36 +78,35 @@ public:
         
         int messages_received = 0;
         
-        while (messages_received < expected_messages) {
-            // Receive sensor data
-            auto msg = subscriber.receive(5.0);  // 5 second timeout
+        subscriber.on_message(subscribe_topic, [&](const std::shared_ptr<MQTTMessage>& msg) {
+            XBT_INFO("[EDGE] Received from topic '%s': %s",
+                     msg->topic.c_str(), msg->payload.c_str());
             
-            if (msg) {
-                XBT_INFO("[EDGE] Received from topic '%s': %s",
-                         msg->topic.c_str(), msg->payload.c_str());
-                
-                // Filter data locally
-                XBT_INFO("[EDGE] Filtering data...");
-                sg4::this_actor::execute(2e8);  // 200 MFlops
-                
-                if (forward_to_fog) {
-                    // Forward filtered data to fog
-                    XBT_INFO("[EDGE] Forwarding to fog (topic: %s)", publish_topic.c_str());
-                    std::string filtered = "filtered:" + msg->payload;
-                    publisher.publish(publish_topic, filtered, 150);
-                    
-                    XBT_INFO("[EDGE] Forwarded filtered data to fog");
-                } else {
-                    XBT_INFO("[EDGE] Processed locally (no fog nodes)");
-                }
+            // Filter data locally
+            XBT_INFO("[EDGE] Filtering data...");
+            sg4::this_actor::execute(2e8);  // 200 MFlops
+            
+            if (forward_to_fog) {
+                // Forward filtered data to fog
+                XBT_INFO("[EDGE] Forwarding to fog (topic: %s)", publish_topic.c_str());
+                std::string filtered = "filtered:" + msg->payload;
+                publisher.publish(publish_topic, filtered, 150);
                 
-                messages_received++;
-                XBT_INFO("[EDGE] Messages processed: %d/%d", messages_received, expected_messages);
+                XBT_INFO("[EDGE] Forwarded filtered data to fog");
             } else {
-                XBT_INFO("[EDGE] Timeout waiting for messages (received %d/%d)",
-                         messages_received, expected_messages);
-                break;
+                XBT_INFO("[EDGE] Processed locally (no fog nodes)");
             }
+            
+            messages_received++;
+            XBT_INFO("[EDGE] Messages processed: %d/%d", messages_received, expected_messages);
+        });
+        
+        // Dispatch until all expected messages arrived or 5 s pass without any
+        subscriber.run(5.0, expected_messages);
+        
+        if (messages_received < expected_messages) {
+            XBT_INFO("[EDGE] Timeout waiting for messages (received %d/%d)",
+                     messages_received, expected_messages);
         }
         
         XBT_INFO("[EDGE] Processing completed (%d messages)", messages_received);